@@ -1,13 +1,75 @@
 #pragma once
 
 #include <algorithm>
+#include <iterator>
 #include <sstream>
 #include <limits>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <set>
 #include <map>
+#include <memory>
 #include <cassert>
+#include <cstdint>
+#include <charconv>
+#include <optional>
+#include <type_traits>
+#include <cstdio>
+#include <deque>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <system_error>
+#include <functional>
+#include <cstdlib>
+#include <cwchar>
+#include <cstring>
+#include <utility>
+#include <mutex>
+
+// Define ARGH_ENABLE_STATS to have parse() fill a parse_stats record (see parser::stats()).
+// Without it the instrumentation compiles to nothing.
+#if defined(ARGH_ENABLE_STATS)
+#  include <chrono>
+#  define ARGH_STATS(...) __VA_ARGS__
+#else
+#  define ARGH_STATS(...)
+#endif
+
+// response files are memory mapped where mmap() exists, read otherwise
+#if defined(__unix__) || defined(__APPLE__)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  define ARGH_HAS_MMAP 1
+#endif
+
+// SIMD scanning of tokens (see detail::find_char()), chosen at compile time: AVX2 when the compiler
+// targets it (-mavx2, /arch:AVX2), SSE2 on x86-64, NEON on ARM64. Define ARGH_NO_SIMD for plain loops.
+#if !defined(ARGH_NO_SIMD)
+#  if defined(__AVX2__)
+#     include <immintrin.h>
+#     define ARGH_SIMD_AVX2 1
+#  elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#     include <emmintrin.h>
+#     define ARGH_SIMD_SSE2 1
+#  elif defined(__ARM_NEON) || defined(_M_ARM64)
+#     include <arm_neon.h>
+#     define ARGH_SIMD_NEON 1
+#  endif
+#  if defined(_MSC_VER) && !defined(__clang__)
+#     include <intrin.h>
+#  endif
+#endif
+
+#if defined(__has_include)
+#  if __has_include(<memory_resource>)
+#     include <memory_resource>
+#     define ARGH_HAS_PMR 1
+#  endif
+#endif
 
 namespace argh
 {
@@ -22,310 +84,4171 @@ namespace argh
 		PREFER_PARAM_FOR_UNREG_OPTION = 1 << 1,
 		NO_SPLIT_ON_EQUALSIGN = 1 << 2,
 		SINGLE_DASH_IS_MULTIFLAG = 1 << 3,
+		EXPAND_RESPONSE_FILES = 1 << 4, // an "@file" arg is replaced by the args read from file
+		LAZY_PARSE = 1 << 5,            // parse() only records the args, accessors parse as far as they need
+		ALLOW_ABBREVIATIONS = 1 << 6,   // "--verb" is "--verbose" if no other known option starts with "verb"
 	};
 
-   template<typename CharType = char>
-   class parser
+   // the two PREFER_ modes exclude each other
+   constexpr bool valid_mode(int mode)
    {
-	   using Tstring = std::basic_string<CharType, std::char_traits<CharType>, std::allocator<CharType>>;
-	   using Tstring_view = std::basic_string_view<CharType>;
-	   using Tistringstream = std::basic_istringstream<CharType, std::char_traits<CharType>, std::allocator<CharType>>;
-	   using Tostringstream = std::basic_ostringstream<CharType, std::char_traits<CharType>, std::allocator<CharType>>;
+      return !(mode & PREFER_FLAG_FOR_UNREG_OPTION) || !(mode & PREFER_PARAM_FOR_UNREG_OPTION);
+   }
 
-   public:
+   // a mode known at compile time, for parse<M>(): the parse loop is instantiated for it, so tests of
+   // its bits are constants and the branches M cannot take are dropped. Converts to the int it stands for.
+   template<int M>
+   struct fixed_mode
+   {
+      static_assert(valid_mode(M), "PREFER_FLAG_FOR_UNREG_OPTION and PREFER_PARAM_FOR_UNREG_OPTION conflict");
+      static constexpr int value = M;
+      constexpr operator int() const { return M; }
+   };
 
-	  parser() = default;
+   namespace detail
+   {
+      // classic-locale whitespace, as skipped by operator>>
+      template<typename CharType>
+      constexpr bool is_space(CharType c)
+      {
+         return ' ' == c || ('\t' <= c && c <= '\r');
+      }
 
-      parser(std::initializer_list<CharType const* const> pre_reg_names)
-      {  add_params(pre_reg_names); }
+      template<typename CharType>
+      constexpr bool is_digit(CharType c)
+      {
+         return '0' <= c && c <= '9';
+      }
 
-      parser(const CharType* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION)
-      {  parse(argv, mode); }
+      // Returns true if extracting a double from [first, last) with operator>> would succeed.
+      // Mirrors the classic-locale num_get rules: leading whitespace is skipped, only a prefix has
+      // to form a number ("-5abc" is a number), an exponent needs digits ("-1e" is not) and
+      // "inf"/"nan" are not accepted. Values that overflow a double fail, just like the stream does.
+      // Scans the characters only, no allocation and no locale.
+      template<typename CharType>
+      bool is_number(CharType const* first, CharType const* last)
+      {
+         auto p = first;
+         while (p != last && is_space(*p))
+            ++p;
+         auto const start = p;
+         if (p != last && ('-' == *p || '+' == *p))
+            ++p;
 
-      parser(int argc, const CharType* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION)
-      {  parse(argc, argv, mode); }
+         // mantissa: significant digits before the point, or leading zeros after it
+         bool found_mantissa = false;
+         long long magnitude = 0;
+         bool nonzero = false;
+         for (; p != last && is_digit(*p); ++p)
+         {
+            found_mantissa = true;
+            nonzero = nonzero || '0' != *p;
+            magnitude += nonzero;
+         }
+         if (p != last && '.' == *p)
+         {
+            ++p;
+            for (; p != last && is_digit(*p); ++p)
+            {
+               found_mantissa = true;
+               if (nonzero)
+                  continue;
+               nonzero = '0' != *p;
+               magnitude -= !nonzero;
+            }
+         }
+         if (!found_mantissa)
+            return false;
 
-      void add_param(Tstring const& name)
-	  {
-		  registeredParams_.insert(trim_leading_dashes(name));
-	  }
+         long long exponent = 0;
+         if (p != last && ('e' == *p || 'E' == *p))
+         {
+            ++p;
+            bool negative = false;
+            if (p != last && ('-' == *p || '+' == *p))
+               negative = '-' == *p++;
+            if (p == last || !is_digit(*p))
+               return false; // "1e" and "1e+" are rejected, not truncated
+            for (; p != last && is_digit(*p); ++p)
+               if (exponent < 100000)
+                  exponent = exponent * 10 + (*p - '0');
+            if (negative)
+               exponent = -exponent;
+         }
 
-	  void add_params(std::initializer_list<CharType const* const> init_list)
-	  {
-		  for (auto& name : init_list)
-			  registeredParams_.insert(trim_leading_dashes(name));
-	  }
+         // the value lies in [10^(magnitude-1), 10^magnitude) * 10^exponent
+         auto const decimal_digits = magnitude + exponent;
+         if (!nonzero || decimal_digits < std::numeric_limits<double>::max_exponent10 + 1)
+            return true;
+         if (decimal_digits > std::numeric_limits<double>::max_exponent10 + 1)
+            return false;
 
-      void parse(const CharType* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION)
-	  {
-		  int argc = 0;
-		  for (auto argvp = argv; *argvp; ++argc, ++argvp);
-		  parse(argc, argv, mode);
-	  }
+         // borderline (~1.8e308): let from_chars decide on a narrowed copy
+         auto out_of_range = [](char const* first, char const* last)
+         {
+            double value;
+            return std::errc::result_out_of_range == std::from_chars('+' == *first ? first + 1 : first, last, value).ec;
+         };
+         char buf[512];
+         size_t n = 0;
+         if (static_cast<size_t>(p - start) <= sizeof(buf))
+         {
+            for (auto q = start; q != p; ++q, ++n)
+               buf[n] = static_cast<char>(*q);
+            return !out_of_range(buf, buf + n);
+         }
+         std::string longer; // very long digit strings, not worth a bigger stack buffer
+         for (auto q = start; q != p; ++q)
+            longer += static_cast<char>(*q);
+         return !out_of_range(longer.data(), longer.data() + longer.size());
+      }
 
-	  void parse(int argc, const CharType* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION)
-	  {
-		  parse(static_cast<size_t>(argc), argv, mode);
-	  }
+      template<typename T>
+      constexpr bool is_character_v = std::is_same_v<T, char> || std::is_same_v<T, signed char> || std::is_same_v<T, unsigned char>
+                                   || std::is_same_v<T, wchar_t> || std::is_same_v<T, char16_t> || std::is_same_v<T, char32_t>;
 
-	  void parse(size_t argc, const CharType* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION);
+      template<typename T>
+      std::optional<T> from_chars(char const* first, char const* last)
+      {
+         if (first != last && '+' == *first) // accepted by operator>>, not by std::from_chars
+            ++first;
+         if constexpr (std::is_floating_point_v<T>)
+         {
+            // std::from_chars also reads "inf" and "nan", which operator>> rejects
+            auto digits = first != last && '-' == *first ? first + 1 : first;
+            if (digits == last || !(is_digit(*digits) || '.' == *digits))
+               return std::nullopt;
+         }
+         T value{};
+         auto res = std::from_chars(first, last, value);
+         if constexpr (std::is_floating_point_v<T>)
+         {
+            // operator>> fails on an exponent without digits ("1e", "1e+"), from_chars stops before it.
+            // An underflow is 0 for the stream, an error for from_chars.
+            if (std::errc() == res.ec && res.ptr != last && ('e' == *res.ptr || 'E' == *res.ptr)
+               && std::none_of(first, res.ptr, [](char c) { return 'e' == c || 'E' == c; }))
+               return std::nullopt;
+            if (std::errc::result_out_of_range == res.ec && is_number(first, last))
+               return '-' == *first ? -T(0) : T(0);
+         }
+         if (std::errc() != res.ec)
+            return std::nullopt;
+         return value;
+      }
 
-      std::multiset<Tstring>        const& flags()    const { return flags_;    }
-      std::map<Tstring, Tstring>    const& params()   const { return params_;   }
-      std::vector<Tstring>          const& pos_args() const { return pos_args_; }
+      // Converts str to T without a stream where possible:
+      // - types constructible from the view (strings, views) get the whole value, spaces included
+      // - arithmetic types use std::from_chars; like operator>>, leading whitespace is skipped and a
+      //   numeric prefix is enough, but out-of-range values fail. Wide CharTypes narrow into a local buffer.
+      // - bool accepts 0 and 1, character types take the first non-space character
+      // - any other T is extracted with operator>>
+      template<typename T, typename CharType>
+      std::optional<T> convert(std::basic_string_view<CharType> str)
+      {
+         if constexpr (std::is_constructible_v<T, std::basic_string_view<CharType>> && !std::is_arithmetic_v<T>)
+         {
+            return T(str);
+         }
+         else if constexpr (std::is_arithmetic_v<T>)
+         {
+            auto p = str.data(), last = str.data() + str.size();
+            while (p != last && is_space(*p))
+               ++p;
 
-      // begin() and end() for using range-for over positional args.
-      typename std::vector<Tstring>::const_iterator begin()  const { return pos_args_.cbegin(); }
-      typename std::vector<Tstring>::const_iterator end()    const { return pos_args_.cend();   }
-      size_t size()                                 const { return pos_args_.size();   }
+            if constexpr (is_character_v<T>)
+            {
+               if (p == last)
+                  return std::nullopt;
+               return static_cast<T>(*p);
+            }
+            else if constexpr (std::is_same_v<T, bool>)
+            {
+               auto v = convert<long, CharType>(str);
+               if (!v || (0 != *v && 1 != *v))
+                  return std::nullopt;
+               return 1 == *v;
+            }
+            else if constexpr (std::is_same_v<CharType, char>)
+            {
+               return from_chars<T>(p, last);
+            }
+            else
+            {
+               // only an ASCII prefix can be part of a number
+               char buf[128];
+               size_t n = 0;
+               for (; p != last && n < sizeof(buf) && 0 < *p && *p < 0x80; ++p, ++n)
+                  buf[n] = static_cast<char>(*p);
+               if (n < sizeof(buf) || p == last || !(0 < *p && *p < 0x80))
+                  return from_chars<T>(buf, buf + n);
 
-      //////////////////////////////////////////////////////////////////////////
-      // Accessors
+               std::string longer(buf, n); // very long digit strings, not worth a bigger stack buffer
+               for (; p != last && 0 < *p && *p < 0x80; ++p)
+                  longer += static_cast<char>(*p);
+               return from_chars<T>(longer.data(), longer.data() + longer.size());
+            }
+         }
+         else
+         {
+            std::basic_istringstream<CharType> istr{ std::basic_string<CharType>(str) };
+            T value;
+            if (istr >> value)
+               return value;
+            return std::nullopt;
+         }
+      }
 
-      // flag (boolean) accessors: return true if the flag appeared, otherwise false.
-      bool operator[](Tstring const& name) const
-	  {
-		  return got_flag(name);
-	  }
+      inline unsigned first_bit(uint64_t mask) // mask != 0
+      {
+#if defined(_MSC_VER) && !defined(__clang__)
+         unsigned long index;
+         if (_BitScanForward(&index, static_cast<unsigned long>(mask)))
+            return index;
+         _BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+         return 32 + index;
+#else
+         return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+      }
 
-      // multiple flag (boolean) accessors: return true if at least one of the flag appeared, otherwise false.
-      bool operator[](std::initializer_list<CharType const* const> init_list) const
-	  {
-		  return std::any_of(init_list.begin(), init_list.end(), [&](CharType const* const name) { return got_flag(name); });
-	  }
+#if defined(ARGH_SIMD_AVX2) || defined(ARGH_SIMD_SSE2) || defined(ARGH_SIMD_NEON)
+#  if defined(ARGH_SIMD_AVX2)
+      constexpr size_t simd_block_bytes = 32, simd_bits_per_byte = 1;
+#  elif defined(ARGH_SIMD_SSE2)
+      constexpr size_t simd_block_bytes = 16, simd_bits_per_byte = 1;
+#  else
+      constexpr size_t simd_block_bytes = 16, simd_bits_per_byte = 4;
+#  endif
 
-	  // returns positional arg string by order. Like argv[] but without the options
-	  Tstring const& operator[](size_t ind) const
-	  {
-		  if (ind < pos_args_.size())
-			  return pos_args_[ind];
-		  return empty_;
-	  }
+      // lanes equal to c in a block of 16 (SSE2, NEON) or 32 (AVX2) bytes at p, as a bit mask with
+      // one bit per byte (SSE2, AVX2) or 4 bits per byte (NEON), all the bits of a lane set alike
+      template<typename CharType>
+      uint64_t match_mask(CharType const* p, CharType c)
+      {
+#  if defined(ARGH_SIMD_AVX2)
+         auto const block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p));
+         __m256i eq;
+         if constexpr (1 == sizeof(CharType))
+            eq = _mm256_cmpeq_epi8(block, _mm256_set1_epi8(static_cast<char>(c)));
+         else if constexpr (2 == sizeof(CharType))
+            eq = _mm256_cmpeq_epi16(block, _mm256_set1_epi16(static_cast<short>(c)));
+         else
+            eq = _mm256_cmpeq_epi32(block, _mm256_set1_epi32(static_cast<int>(c)));
+         return static_cast<uint32_t>(_mm256_movemask_epi8(eq));
+#  elif defined(ARGH_SIMD_SSE2)
+         auto const block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+         __m128i eq;
+         if constexpr (1 == sizeof(CharType))
+            eq = _mm_cmpeq_epi8(block, _mm_set1_epi8(static_cast<char>(c)));
+         else if constexpr (2 == sizeof(CharType))
+            eq = _mm_cmpeq_epi16(block, _mm_set1_epi16(static_cast<short>(c)));
+         else
+            eq = _mm_cmpeq_epi32(block, _mm_set1_epi32(static_cast<int>(c)));
+         return static_cast<uint32_t>(_mm_movemask_epi8(eq));
+#  else
+         auto const block = vld1q_u8(reinterpret_cast<uint8_t const*>(p));
+         uint8x16_t eq;
+         if constexpr (1 == sizeof(CharType))
+            eq = vceqq_u8(block, vdupq_n_u8(static_cast<uint8_t>(c)));
+         else if constexpr (2 == sizeof(CharType))
+            eq = vreinterpretq_u8_u16(vceqq_u16(vreinterpretq_u16_u8(block), vdupq_n_u16(static_cast<uint16_t>(c))));
+         else
+            eq = vreinterpretq_u8_u32(vceqq_u32(vreinterpretq_u32_u8(block), vdupq_n_u32(static_cast<uint32_t>(c))));
+         return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+#  endif
+      }
+#endif
 
-      // returns a std::istream that can be used to convert a positional arg to a typed value.
-      Tistringstream operator()(size_t ind) const
-	  {
-		  if (pos_args_.size() <= ind)
-			  return bad_stream();
+      // Index of the first c in p[0, n) if Equal, of the first character other than c otherwise; n if
+      // there is none. Whole blocks are compared at once, so long tokens (--payload=<base64>) cost a
+      // fraction of a loop per character; the tail and short tokens use the loop.
+      template<bool Equal, typename CharType>
+      size_t find_char(CharType const* p, size_t n, CharType c)
+      {
+         size_t i = 0;
+#if defined(ARGH_SIMD_AVX2) || defined(ARGH_SIMD_SSE2) || defined(ARGH_SIMD_NEON)
+         constexpr size_t lanes = simd_block_bytes / sizeof(CharType);
+         constexpr size_t bits = simd_bits_per_byte * simd_block_bytes;
+         constexpr uint64_t all = 64 == bits ? ~uint64_t(0) : (uint64_t(1) << bits) - 1;
+         for (; i + lanes <= n; i += lanes)
+         {
+            auto mask = match_mask(p + i, c);
+            if (!Equal)
+               mask = ~mask & all;
+            if (mask)
+               return i + first_bit(mask) / simd_bits_per_byte / sizeof(CharType);
+         }
+#endif
+         for (; i < n && Equal != (c == p[i]); ++i);
+         return i;
+      }
 
-		  return Tistringstream(pos_args_[ind]);
-	  }
+      // length of a null-terminated string. Not in blocks: the end of the allocation is not known, so
+      // only the characters up to the terminator may be read
+      template<typename CharType>
+      size_t length(CharType const* s)
+      {
+         if constexpr (std::is_same_v<CharType, wchar_t>)
+            return std::wcslen(s); // vectorized by the C library, like strlen
+         else
+            return std::char_traits<CharType>::length(s);
+      }
 
-      // same as above, but with a default value in case the arg is missing (index out of range).
-      template<typename T>
-      Tistringstream operator()(size_t ind, T&& def_val) const
-	  {
-		  if (pos_args_.size() <= ind)
-		  {
-			  Tostringstream ostr;
-			  ostr.precision(std::numeric_limits<long double>::max_digits10);
-			  ostr << def_val;
-			  return Tistringstream(ostr.str());
-		  }
+      // a range of string objects (std::string, std::string_view...) of CharType, not of pointers
+      template<typename Range, typename CharType, typename = void>
+      constexpr bool is_string_range_v = false;
 
-		  return Tistringstream(pos_args_[ind]);
-	  }
+      template<typename Range, typename CharType>
+      constexpr bool is_string_range_v<Range, CharType, std::void_t<decltype(*std::begin(std::declval<Range&>()))>> =
+         std::is_class_v<std::remove_cv_t<std::remove_reference_t<decltype(*std::begin(std::declval<Range&>()))>>> &&
+         std::is_convertible_v<decltype(*std::begin(std::declval<Range&>())), std::basic_string_view<CharType>>;
 
-      // parameter accessors, give a name get an std::istream that can be used to convert to a typed value.
-      // call .str() on result to get as string
-      Tistringstream operator()(Tstring const& name) const
-	  {
-		  auto optIt = params_.find(trim_leading_dashes(name));
-		  if (params_.end() != optIt)
-			  return Tistringstream(optIt->second);
-		  return bad_stream();
-	  }
+      // what the classification pass records per token
+      struct token_info
+      {
+         static constexpr uint32_t npos = ~uint32_t(0);
 
-      // accessor for a parameter with multiple names, give a list of names, get an std::istream that can be used to convert to a typed value.
-      // call .str() on result to get as string
-      // returns the first value in the list to be found.
-      Tistringstream operator()(std::initializer_list<CharType const* const> init_list) const
-	  {
-		  for (auto& name : init_list)
-		  {
-			  auto optIt = params_.find(trim_leading_dashes(name));
-			  if (params_.end() != optIt)
-				  return Tistringstream(optIt->second);
-		  }
-		  return bad_stream();
-	  }
+         uint32_t dashes = 0;       // length of the leading '-' (or '/') run that trim_leading_dashes() drops
+         uint32_t equal  = npos;    // offset of the first '=' after the dashes, npos if none or not splitting
+         bool option     = false;   // false: positional arg
+      };
 
-      // same as above, but with a default value in case the param was missing.
-      // Non-string def_val types must have an operator<<() (output stream operator)
-      // If T only has an input stream operator, pass the string version of the type as in "3" instead of 3.
-      template<typename T>
-      Tistringstream operator()(Tstring const& name, T&& def_val) const
-	  {
-		  auto optIt = params_.find(trim_leading_dashes(name));
-		  if (params_.end() != optIt)
-			  return Tistringstream(optIt->second);
+      // length of the leading '-' run, or of the '/' run (JB's special case) if there is no '-'.
+      // a token made only of dashes keeps them all.
+      template<typename CharType>
+      uint32_t leading_dashes(std::basic_string_view<CharType> arg)
+      {
+         auto count = [&](CharType c) { return find_char<false>(arg.data(), arg.size(), c); };
+         auto n = count('-');
+         if (0 == n || arg.size() == n)
+            n = count('/');
+         return static_cast<uint32_t>(arg.size() == n ? 0 : n);
+      }
 
-		  Tostringstream ostr;
-		  ostr.precision(std::numeric_limits<long double>::max_digits10);
-		  ostr << def_val;
-		  return Tistringstream(ostr.str()); // use default
-	  }
+      // classifies arg in one scan: option-ness (numbers starting with '-' are not options), dash count
+      // and the position of '=' (the '=' search starts where the dashes end).
+      template<typename CharType>
+      token_info classify(std::basic_string_view<CharType> arg, bool split_on_equal)
+      {
+         token_info tok;
+         // JB: added the '/' special case
+         // only a leading '-' can start a number, so the numeric scan is skipped for everything else.
+         tok.option = !arg.empty() && ('/' == arg[0] || ('-' == arg[0] && !is_number(arg.data(), arg.data() + arg.size())));
+         if (!tok.option)
+            return tok;
 
-      // same as above but for a list of names. returns the first value to be found.
-      template<typename T>
-      Tistringstream operator()(std::initializer_list<CharType const* const> init_list, T&& def_val) const
-	  {
-		  for (auto& name : init_list)
-		  {
-			  auto optIt = params_.find(trim_leading_dashes(name));
-			  if (params_.end() != optIt)
-				  return Tistringstream(optIt->second);
-		  }
-		  Tostringstream ostr;
-		  ostr.precision(std::numeric_limits<long double>::max_digits10);
-		  ostr << def_val;
-		  return Tistringstream(ostr.str()); // use default
-	  }
+         tok.dashes = leading_dashes(arg);
+         if (split_on_equal)
+         {
+            auto pos = find_char<true>(arg.data() + tok.dashes, arg.size() - tok.dashes, CharType('='));
+            if (pos != arg.size() - tok.dashes)
+               tok.equal = static_cast<uint32_t>(pos);
+         }
+         return tok;
+      }
 
-   private:
-      Tistringstream bad_stream() const
-	  {
-		  Tistringstream bad;
-		  bad.setstate(std::ios_base::failbit);
-		  return bad;
-	  }
+      struct identity_key
+      {
+         template<typename T>
+         T const& operator()(T const& value) const { return value; }
+      };
 
-	  // JB: added the '/' special case
-      Tstring trim_leading_dashes(Tstring const& name) const
-	  {
-		  auto pos = name.find_first_not_of('-');
-		  if (!pos || (pos == Tstring::npos))
-			  pos = name.find_first_not_of('/');
-		  return Tstring::npos != pos ? name.substr(pos) : name;
-	  }
+      struct first_key
+      {
+         template<typename T>
+         typename T::first_type const& operator()(T const& value) const { return value.first; }
+      };
+   }
 
-      bool is_number(Tstring const& arg) const
-	  {
-		  // inefficient but simple way to determine if a string is a number (which can start with a '-')
-		  Tistringstream istr(arg);
-		  double number;
-		  istr >> number;
-		  return !(istr.fail() || istr.bad());
-	  }
-	  
-	  // JB: added the '/' special case
-	  bool is_option(Tstring const& arg) const
-	  {
-		  assert(0 != arg.size());
-		  if (is_number(arg))
-			  return false;
-		  return (('-' == arg[0]) || ('/' == arg[0]));
-	  }
+   //////////////////////////////////////////////////////////////////////////
+   // Flat storage: a contiguous vector ordered by key (std::less<>, so lookups are transparent).
+   // emplace() appends without searching and seal() sorts the appended tail and merges it in, so
+   // building from n tokens costs one O(n log n) sort instead of n node allocations.
+   // The parser seals after every parse(); lookups stay correct on an unsealed tail (it is scanned linearly).
+   // With Unique, the first inserted value of a key wins, as with std::map::insert().
+   template<typename Value, typename KeyOf, bool Unique, typename Allocator = std::allocator<Value>>
+   class flat_tree
+   {
+   public:
+      using value_type     = Value;
+      using allocator_type = Allocator;
+      using const_iterator = typename std::vector<Value, Allocator>::const_iterator;
+      using iterator       = const_iterator;
+      using size_type      = size_t;
 
-      bool got_flag(Tstring const& name) const
-	  {
-		  return flags_.end() != flags_.find(trim_leading_dashes(name));
-	  }
+      flat_tree() = default;
+      explicit flat_tree(Allocator const& alloc) : data_(alloc), scratch_(alloc) {}
 
-      bool is_param(Tstring const& name) const
-	  {
-		  return registeredParams_.count(name) ? true : false;
-	  }
+      allocator_type get_allocator() const { return data_.get_allocator(); }
 
-   private:
-      std::vector<Tstring> args_;
-      std::map<Tstring, Tstring> params_;
-      std::vector<Tstring> pos_args_;
-      std::multiset<Tstring> flags_;
-      std::set<Tstring> registeredParams_;
-      Tstring empty_;
-   };
+      const_iterator begin()  const { return data_.cbegin(); }
+      const_iterator end()    const { return data_.cend();   }
+      const_iterator cbegin() const { return data_.cbegin(); }
+      const_iterator cend()   const { return data_.cend();   }
+      size_t size()           const { return data_.size();   }
+      bool empty()            const { return data_.empty();  }
 
+      void clear()             { data_.clear(); sorted_ = 0; }
+      void reserve(size_t n)   { data_.reserve(n); }
+      size_t capacity()  const { return data_.capacity(); }
 
-   //////////////////////////////////////////////////////////////////////////
+      template<typename... Args>
+      void emplace(Args&&... args)
+      {
+         data_.emplace_back(std::forward<Args>(args)...);
+      }
 
-   template<typename CharType>
-   inline void parser<CharType>::parse(size_t argc, const CharType* const argv[], int mode /*= PREFER_FLAG_FOR_UNREG_OPTION*/)
-   {
-      // convert to strings
-      args_.resize(argc);
-      std::transform(argv, argv + argc, args_.begin(), [](const CharType* const arg) { return arg;  });
+      template<typename K>
+      const_iterator find(K const& key) const
+      {
+         auto sorted_end = data_.cbegin() + sorted_;
+         auto it = std::lower_bound(data_.cbegin(), sorted_end, key, key_less());
+         if (it != sorted_end && !std::less<>()(key, KeyOf()(*it)))
+            return it;
+         return std::find_if(sorted_end, data_.cend(), [&](Value const& v) { return key_equal(KeyOf()(v), key); });
+      }
 
-      // parse line
-      for (auto i = 0u; i < args_.size(); ++i)
+      template<typename K>
+      size_t count(K const& key) const
       {
-         if (!is_option(args_[i]))
-         {
-            pos_args_.emplace_back(args_[i]);
-            continue;
-         }
+         if constexpr (Unique)
+            return find(key) != end() ? 1 : 0;
+         auto sorted_end = data_.cbegin() + sorted_;
+         auto range = std::equal_range(data_.cbegin(), sorted_end, key, key_less());
+         auto n = static_cast<size_t>(range.second - range.first);
+         return n + std::count_if(sorted_end, data_.cend(), [&](Value const& v) { return key_equal(KeyOf()(v), key); });
+      }
+
+      // sorted range of the values equal to key (the unsealed tail is not included)
+      template<typename K>
+      std::pair<const_iterator, const_iterator> equal_range(K const& key) const
+      {
+         return std::equal_range(data_.cbegin(), data_.cbegin() + sorted_, key, key_less());
+      }
 
-         auto name = trim_leading_dashes(args_[i]);
+      void seal()
+      {
+         seal([](Value&&) {});
+      }
 
-         if (!(mode & NO_SPLIT_ON_EQUALSIGN))
+      // with Unique, the values dropped for a key that is already there are passed to spill(Value&&),
+      // in insertion order
+      template<typename Spill>
+      void seal(Spill&& spill)
+      {
+         if (sorted_ == data_.size())
+            return;
+         auto middle = data_.begin() + sorted_;
+         stable_sort(middle, data_.end());
+         merge(data_.begin(), middle, data_.end()); // stable: earlier values first
+         if constexpr (Unique)
          {
-            auto equalPos = name.find('=');
-            if (equalPos != Tstring::npos)
+            auto kept = data_.begin();
+            for (auto it = std::next(kept); it != data_.end(); ++it)
             {
-               params_.insert({ name.substr(0, equalPos), name.substr(equalPos + 1) });
-               continue;
+               if (key_equal(KeyOf()(*kept), KeyOf()(*it)))
+                  spill(std::move(*it));
+               else if (++kept != it)
+                  *kept = std::move(*it);
             }
+            data_.erase(std::next(kept), data_.end());
          }
+         sorted_ = data_.size();
+      }
 
-         // if the option is unregistered and should be a multi-flag
-         if (1 == (args_[i].size() - name.size()) &&         // single dash
-            Mode::SINGLE_DASH_IS_MULTIFLAG & mode && // multi-flag mode
-            !is_param(name))                                  // unregistered
-         {
-            Tstring keep_param;
+   private:
+      struct key_less
+      {
+         template<typename K>
+         bool operator()(Value const& v, K const& key) const { return std::less<>()(KeyOf()(v), key); }
+         template<typename K>
+         bool operator()(K const& key, Value const& v) const { return std::less<>()(key, KeyOf()(v)); }
+         // sets looked up by their own value type (e.g. a view_parser's flags)
+         bool operator()(Value const& a, Value const& b) const { return by_key(a, b); }
+      };
 
-            if (!name.empty() && is_param(Tstring(1ul, name.back()))) // last char is param
-            {
-               keep_param += name.back();
-               name.resize(name.size() - 1);
-            }
+      template<typename A, typename B>
+      static bool key_equal(A const& a, B const& b) { return !std::less<>()(a, b) && !std::less<>()(b, a); }
 
-            for (auto const& c : name)
-            {
-               flags_.emplace(Tstring{ c });
-            }
+      static bool by_key(Value const& a, Value const& b) { return std::less<>()(KeyOf()(a), KeyOf()(b)); }
 
-            if (!keep_param.empty())
-            {
-               name = keep_param;
-            }
-            else
-            {
-               continue; // do not consider other options for this arg
-            }
-         }
+      using iter = typename std::vector<Value, Allocator>::iterator;
 
-         // any potential option will get as its value the next arg, unless that arg is an option too
-         // in that case it will be determined a flag.
-         if (i == args_.size() - 1 || is_option(args_[i + 1]))
+      // std::stable_sort and std::inplace_merge allocate a buffer on every call. These merge through
+      // scratch_ instead, whose capacity is kept: a table that is cleared and refilled stops allocating.
+      void stable_sort(iter first, iter last)
+      {
+         size_t const n = static_cast<size_t>(last - first), run = 16;
+         for (auto block = first; block != last; block += std::min(run, static_cast<size_t>(last - block)))
          {
-            flags_.emplace(name);
-            continue;
+            auto block_end = block + std::min(run, static_cast<size_t>(last - block));
+            for (auto it = block + 1; it < block_end; ++it) // insertion sort, stable
+               for (auto back = it; back != block && by_key(*back, *(back - 1)); --back)
+                  std::iter_swap(back, back - 1);
          }
+         for (size_t width = run; width < n; width *= 2)
+            for (size_t low = 0; low + width < n; low += 2 * width)
+               merge(first + low, first + low + width, first + std::min(low + 2 * width, n));
+      }
+
+      void merge(iter first, iter middle, iter last)
+      {
+         if (first == middle || middle == last || !by_key(*middle, *(middle - 1)))
+            return;
+         scratch_.clear();
+         std::merge(std::make_move_iterator(first), std::make_move_iterator(middle),
+                    std::make_move_iterator(middle), std::make_move_iterator(last), std::back_inserter(scratch_), by_key);
+         std::move(scratch_.begin(), scratch_.end(), first);
+         scratch_.clear();
+      }
+
+      std::vector<Value, Allocator> data_;
+      std::vector<Value, Allocator> scratch_; // merge buffer, see stable_sort()
+      size_t sorted_ = 0;
+   };
+
+   namespace detail
+   {
+      template<typename Allocator, typename T>
+      using rebind_alloc = typename std::allocator_traits<Allocator>::template rebind_alloc<T>;
+   }
 
-         // if 'name' is a pre-registered option, then the next arg cannot be a free parameter to it is skipped
-         // otherwise we have 2 modes:
-         // PREFER_FLAG_FOR_UNREG_OPTION: a non-registered 'name' is determined a flag.
-         //                               The following value (the next arg) will be a free parameter.
-         //
-         // PREFER_PARAM_FOR_UNREG_OPTION: a non-registered 'name' is determined a parameter, the next arg
-         //                                will be the value of that option.
+   template<typename Key, typename Value, typename Allocator = std::allocator<std::pair<Key, Value>>>
+   using flat_map = flat_tree<std::pair<Key, Value>, detail::first_key, true, detail::rebind_alloc<Allocator, std::pair<Key, Value>>>;
 
-         assert(!(mode & Mode::PREFER_FLAG_FOR_UNREG_OPTION)
-             || !(mode & Mode::PREFER_PARAM_FOR_UNREG_OPTION));
+   template<typename Key, typename Value, typename Allocator = std::allocator<std::pair<Key, Value>>>
+   using flat_multimap = flat_tree<std::pair<Key, Value>, detail::first_key, false, detail::rebind_alloc<Allocator, std::pair<Key, Value>>>;
 
-         bool preferParam = mode & Mode::PREFER_PARAM_FOR_UNREG_OPTION;
+   template<typename Key, typename Allocator = std::allocator<Key>>
+   using flat_multiset = flat_tree<Key, detail::identity_key, false, detail::rebind_alloc<Allocator, Key>>;
 
-         if (is_param(name) || preferParam)
+   template<typename Key, typename Allocator = std::allocator<Key>>
+   using flat_set = flat_tree<Key, detail::identity_key, true, detail::rebind_alloc<Allocator, Key>>;
+
+   //////////////////////////////////////////////////////////////////////////
+   // Storage policies, selecting the containers parser uses for params, flags and registered names.
+   // Allocator is the parser's allocator (rebound as needed).
+
+   // node based std containers, the default
+   struct tree_storage
+   {
+      template<typename Key, typename Value, typename Allocator>
+      using map = std::map<Key, Value, std::less<>, detail::rebind_alloc<Allocator, std::pair<const Key, Value>>>;
+      template<typename Key, typename Value, typename Allocator>
+      using multimap = std::multimap<Key, Value, std::less<>, detail::rebind_alloc<Allocator, std::pair<const Key, Value>>>;
+      template<typename Key, typename Allocator>
+      using multiset = std::multiset<Key, std::less<>, detail::rebind_alloc<Allocator, Key>>;
+      template<typename Key, typename Allocator>
+      using set = std::set<Key, std::less<>, detail::rebind_alloc<Allocator, Key>>;
+   };
+
+   // sorted contiguous vectors, see flat_tree
+   struct flat_storage
+   {
+      template<typename Key, typename Value, typename Allocator>
+      using map = flat_map<Key, Value, Allocator>;
+      template<typename Key, typename Value, typename Allocator>
+      using multimap = flat_multimap<Key, Value, Allocator>;
+      template<typename Key, typename Allocator>
+      using multiset = flat_multiset<Key, Allocator>;
+      template<typename Key, typename Allocator>
+      using set = flat_set<Key, Allocator>;
+   };
+
+   namespace detail
+   {
+      // the point where a container built by parse() is complete
+      template<typename Container>
+      void seal(Container&) {}
+
+      template<typename Value, typename KeyOf, bool Unique, typename Allocator>
+      void seal(flat_tree<Value, KeyOf, Unique, Allocator>& container) { container.seal(); }
+
+      // params keep the first value of a name, the values of its repeats go to 'repeated' (a multimap)
+      // (value may be moved from, so the key is looked up before anything is built)
+      template<typename Map, typename Multimap, typename K, typename V>
+      void emplace_param(Map& params, Multimap& repeated, K const& name, V&& value)
+      {
+         auto it = params.lower_bound(name);
+         if (params.end() != it && !params.key_comp()(name, it->first))
+            repeated.emplace(name, std::forward<V>(value));
+         else
+            params.emplace_hint(it, name, std::forward<V>(value));
+      }
+
+      // ... a flat map finds its repeats when it is sealed
+      template<typename Value, typename KeyOf, typename Allocator, typename Multimap, typename K, typename V>
+      void emplace_param(flat_tree<Value, KeyOf, true, Allocator>& params, Multimap&, K const& name, V&& value)
+      {
+         params.emplace(name, std::forward<V>(value));
+      }
+
+      template<typename Map, typename Multimap>
+      void seal_params(Map&, Multimap&) {}
+
+      template<typename Value, typename KeyOf, typename Allocator, typename Multimap>
+      void seal_params(flat_tree<Value, KeyOf, true, Allocator>& params, Multimap& repeated)
+      {
+         params.seal([&](Value&& value) { repeated.emplace(std::move(value)); });
+         seal(repeated);
+      }
+
+#if defined(ARGH_ENABLE_STATS)
+      inline size_t& allocation_count()
+      {
+         thread_local size_t count = 0;
+         return count;
+      }
+
+      // Base, counting its allocations in allocation_count()
+      template<typename Base>
+      struct counting_allocator : Base
+      {
+         template<typename T>
+         struct rebind { using other = counting_allocator<rebind_alloc<Base, T>>; };
+
+         counting_allocator() = default;
+
+         template<typename Other, typename = std::enable_if_t<std::is_constructible_v<Base, Other const&>>>
+         counting_allocator(Other const& other) : Base(other) {}
+
+         typename std::allocator_traits<Base>::pointer allocate(size_t n)
          {
-            params_.insert({ name, args_[i + 1] });
-            ++i; // skip next value, it is not a free parameter
-            continue;
+            ++allocation_count();
+            return std::allocator_traits<Base>::allocate(*this, n);
          }
-         else
+
+         void deallocate(typename std::allocator_traits<Base>::pointer p, size_t n)
          {
-            flags_.emplace(name);
+            std::allocator_traits<Base>::deallocate(*this, p, n);
          }
       };
+
+      template<typename Allocator>
+      using container_allocator = counting_allocator<Allocator>;
+#else
+      template<typename Allocator>
+      using container_allocator = Allocator;
+#endif
+
+      // the allocator of an owning StringType, std::allocator for views
+      template<typename StringType, typename = void>
+      struct string_allocator
+      {
+         using type = std::allocator<typename StringType::value_type>;
+      };
+
+      template<typename StringType>
+      struct string_allocator<StringType, std::void_t<typename StringType::allocator_type>>
+      {
+         using type = typename StringType::allocator_type;
+      };
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   // Response files (EXPAND_RESPONSE_FILES): an "@file" arg is replaced by the args in file, split
+   // like a POSIX shell splits words. Files are read once and tokenized in place; with a view_parser,
+   // args that need no unquoting point straight into the mapped file.
+
+   namespace detail
+   {
+      // a read-only image of a whole file: mapped where mmap() is available, read into memory
+      // otherwise (or when the file cannot be mapped, e.g. a pipe). Not movable, contents() stays put.
+      class mapped_file
+      {
+      public:
+         explicit mapped_file(char const* path)
+         {
+#if defined(ARGH_HAS_MMAP)
+            int fd = ::open(path, O_RDONLY);
+            if (fd < 0)
+               return;
+            struct stat st;
+            if (0 == ::fstat(fd, &st) && S_ISREG(st.st_mode))
+            {
+               open_ = true;
+               size_ = static_cast<size_t>(st.st_size);
+               void* addr = size_ ? ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+               if (MAP_FAILED != addr || !size_)
+               {
+                  data_ = MAP_FAILED != addr ? static_cast<char const*>(addr) : nullptr;
+                  mapped_ = MAP_FAILED != addr;
+                  ::close(fd);
+                  return;
+               }
+            }
+            if (std::FILE* file = ::fdopen(fd, "rb"))
+               read(file);
+            else
+               ::close(fd);
+#else
+            if (std::FILE* file = std::fopen(path, "rb"))
+               read(file);
+#endif
+         }
+
+#if defined(_WIN32)
+         explicit mapped_file(wchar_t const* path)
+         {
+            if (std::FILE* file = ::_wfopen(path, L"rb"))
+               read(file);
+         }
+#endif
+
+         mapped_file(mapped_file const&) = delete;
+         mapped_file& operator=(mapped_file const&) = delete;
+
+         ~mapped_file()
+         {
+#if defined(ARGH_HAS_MMAP)
+            if (mapped_)
+               ::munmap(const_cast<char*>(data_), size_);
+#endif
+         }
+
+         bool is_open() const { return open_; }
+         std::string_view contents() const { return std::string_view(data_, size_); }
+
+      private:
+         // takes ownership of file
+         void read(std::FILE* file)
+         {
+            char chunk[4096];
+            for (size_t n; 0 < (n = std::fread(chunk, 1, sizeof(chunk), file));)
+               buffer_.append(chunk, n);
+            open_ = !std::ferror(file);
+            std::fclose(file);
+            data_ = buffer_.data();
+            size_ = buffer_.size();
+         }
+
+         char const* data_ = nullptr;
+         size_t size_ = 0;
+         bool open_ = false;
+         bool mapped_ = false;
+         std::string buffer_;
+      };
+
+      // Transcoding between the encodings of the CharTypes: UTF-8 for 1 byte ones, UTF-16 for 2 byte
+      // ones (wchar_t on Windows) and UTF-32 otherwise. An invalid sequence becomes U+FFFD.
+
+      // the code point at in[i], i is moved past it
+      template<typename CharType>
+      char32_t next_code_point(std::basic_string_view<CharType> in, size_t& i)
+      {
+         if constexpr (1 == sizeof(CharType))
+         {
+            auto const lead = static_cast<unsigned char>(in[i]);
+            size_t const len = lead < 0x80 ? 1 : 6 == (lead >> 5) ? 2 : 14 == (lead >> 4) ? 3 : 30 == (lead >> 3) ? 4 : 0;
+            char32_t cp = 1 == len ? lead : lead & (0x7F >> len);
+            bool valid = 0 != len && i + len <= in.size();
+            for (size_t k = 1; valid && k < len; ++k)
+            {
+               auto const c = static_cast<unsigned char>(in[i + k]);
+               valid = 2 == (c >> 6);
+               cp = (cp << 6) | (c & 0x3F);
+            }
+            constexpr char32_t shortest[] = { 0, 0, 0x80, 0x800, 0x10000 };
+            if (valid && (cp < shortest[len] || 0x10FFFF < cp || (0xD800 <= cp && cp <= 0xDFFF)))
+               valid = false;
+            i += valid ? len : 1;
+            return valid ? cp : 0xFFFD;
+         }
+         else
+         {
+            char32_t cp = 2 == sizeof(CharType) ? static_cast<char16_t>(in[i]) : static_cast<char32_t>(in[i]);
+            ++i;
+            if (2 == sizeof(CharType) && 0xD800 <= cp && cp < 0xDC00 && i < in.size())
+            {
+               char32_t const low = static_cast<char16_t>(in[i]);
+               if (0xDC00 <= low && low <= 0xDFFF)
+               {
+                  cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                  ++i;
+               }
+            }
+            return 0x10FFFF < cp || (0xD800 <= cp && cp <= 0xDFFF) ? 0xFFFD : cp;
+         }
+      }
+
+      template<typename CharType, typename String>
+      void append_code_point(String& out, char32_t cp)
+      {
+         if constexpr (1 == sizeof(CharType))
+         {
+            if (cp < 0x80)
+               out += static_cast<CharType>(cp);
+            else if (cp < 0x800)
+            {
+               out += static_cast<CharType>(0xC0 | (cp >> 6));
+               out += static_cast<CharType>(0x80 | (cp & 0x3F));
+            }
+            else if (cp < 0x10000)
+            {
+               out += static_cast<CharType>(0xE0 | (cp >> 12));
+               out += static_cast<CharType>(0x80 | ((cp >> 6) & 0x3F));
+               out += static_cast<CharType>(0x80 | (cp & 0x3F));
+            }
+            else
+            {
+               out += static_cast<CharType>(0xF0 | (cp >> 18));
+               out += static_cast<CharType>(0x80 | ((cp >> 12) & 0x3F));
+               out += static_cast<CharType>(0x80 | ((cp >> 6) & 0x3F));
+               out += static_cast<CharType>(0x80 | (cp & 0x3F));
+            }
+         }
+         else if (2 == sizeof(CharType) && 0x10000 <= cp)
+         {
+            out += static_cast<CharType>(0xD800 + ((cp - 0x10000) >> 10));
+            out += static_cast<CharType>(0xDC00 + ((cp - 0x10000) & 0x3FF));
+         }
+         else
+            out += static_cast<CharType>(cp);
+      }
+
+      // appends in, converted to the encoding of To. Same size CharTypes are copied as they are and
+      // ASCII runs are copied without decoding.
+      template<typename To, typename From, typename String>
+      void append_transcoded(String& out, std::basic_string_view<From> in)
+      {
+         if constexpr (sizeof(To) == sizeof(From))
+            out.append(in.begin(), in.end());
+         else
+         {
+            out.reserve(out.size() + in.size());
+            for (size_t i = 0; i < in.size();)
+            {
+               size_t ascii = i;
+               while (ascii < in.size() && static_cast<std::make_unsigned_t<From>>(in[ascii]) < 0x80)
+                  ++ascii;
+               out.append(in.begin() + i, in.begin() + ascii);
+               if ((i = ascii) < in.size())
+                  append_code_point<To>(out, next_code_point(in, i));
+            }
+         }
+      }
+
+      // opens the response file 'path' names (the arg without its '@'), UTF-8 encoded except for wide
+      // paths on Windows
+      template<typename CharType>
+      std::unique_ptr<mapped_file> open_response_file(std::basic_string_view<CharType> path)
+      {
+#if defined(_WIN32)
+         if constexpr (sizeof(wchar_t) == sizeof(CharType) && !std::is_same_v<char, CharType>)
+            return std::make_unique<mapped_file>(std::wstring(path.begin(), path.end()).c_str());
+#endif
+         std::string narrow;
+         if constexpr (std::is_same_v<char, CharType>)
+            narrow.assign(path);
+         else
+            append_transcoded<char>(narrow, path);
+         return std::make_unique<mapped_file>(narrow.c_str());
+      }
+
+      // the value of an environment variable, UTF-8 decoded for wide CharTypes (UTF-16 from Windows)
+      template<typename CharType>
+      std::optional<std::basic_string<CharType>> read_env(std::string const& variable)
+      {
+#if defined(_WIN32)
+         if constexpr (sizeof(wchar_t) == sizeof(CharType) && !std::is_same_v<char, CharType>)
+         {
+            auto const value = _wgetenv(std::wstring(variable.begin(), variable.end()).c_str());
+            if (!value)
+               return std::nullopt;
+            return std::basic_string<CharType>(value, value + std::wcslen(value));
+         }
+#endif
+         auto const value = std::getenv(variable.c_str());
+         if (!value)
+            return std::nullopt;
+         std::basic_string<CharType> decoded;
+         append_transcoded<CharType>(decoded, std::string_view(value));
+         return decoded;
+      }
+
+      // Splits text into args in a single pass: whitespace separates args, '...' quotes literally,
+      // "..." quotes with \" \\ \$ \` escapes, a backslash outside quotes escapes the next character
+      // (a backslash-newline joins lines) and a '#' starting an arg comments out the rest of the line.
+      // Calls fn(arg, unquoted): verbatim args are sub-views of text, unquoted ones are in scratch,
+      // which the next call overwrites.
+      template<typename Fn>
+      void tokenize_response(std::string_view text, std::string& scratch, Fn&& fn)
+      {
+         auto const n = text.size();
+         auto special = [](char c) { return '\'' == c || '"' == c || '\\' == c; };
+         for (size_t i = 0;;)
+         {
+            while (i < n && is_space(text[i]))
+               ++i;
+            if (i == n)
+               return;
+            if ('#' == text[i])
+            {
+               while (i < n && '\n' != text[i])
+                  ++i;
+               continue;
+            }
+
+            auto const start = i;
+            while (i < n && !is_space(text[i]) && !special(text[i]))
+               ++i;
+            if (i == n || is_space(text[i]))
+            {
+               fn(text.substr(start, i - start), false);
+               continue;
+            }
+
+            scratch.assign(text.data() + start, i - start);
+            bool quoted = false;
+            while (i < n && !is_space(text[i]))
+            {
+               auto const c = text[i++];
+               if ('\'' == c)
+               {
+                  quoted = true;
+                  for (; i < n && '\'' != text[i]; ++i)
+                     scratch += text[i];
+                  i += i < n;
+               }
+               else if ('"' == c)
+               {
+                  quoted = true;
+                  for (; i < n && '"' != text[i]; ++i)
+                  {
+                     if ('\\' == text[i] && i + 1 < n && std::string_view("\"\\$`\n").find(text[i + 1]) != std::string_view::npos)
+                        if ('\n' == text[++i])
+                           continue;
+                     scratch += text[i];
+                  }
+                  i += i < n;
+               }
+               else if ('\\' == c)
+               {
+                  if (i < n && '\n' != text[i])
+                     scratch += text[i];
+                  i += i < n;
+               }
+               else
+                  scratch += c;
+            }
+            if (quoted || !scratch.empty())
+               fn(std::string_view(scratch), true);
+         }
+      }
+
+      // Reads an INI file in a single pass, without copies: "[section]" starts a section, "key = value" or
+      // a lone "key" (a flag) is an entry and a line starting with '#' or ';' is a comment. Spaces around
+      // keys and values are dropped, as is one pair of "..." or '...' quotes around a value.
+      // Calls fn(section, key, value, line) with sub-views of text, value being nullopt for a flag.
+      template<typename Fn>
+      void tokenize_config(std::string_view text, Fn&& fn)
+      {
+         auto trim = [](std::string_view s)
+         {
+            while (!s.empty() && is_space(s.front()))
+               s.remove_prefix(1);
+            while (!s.empty() && is_space(s.back()))
+               s.remove_suffix(1);
+            return s;
+         };
+
+         if (0 == text.compare(0, 3, "\xEF\xBB\xBF")) // UTF-8 byte order mark
+            text.remove_prefix(3);
+         std::string_view section;
+         uint32_t line = 0;
+         for (size_t pos = 0; pos < text.size(); )
+         {
+            auto end = text.find('\n', pos);
+            if (std::string_view::npos == end)
+               end = text.size();
+            auto row = trim(text.substr(pos, end - pos));
+            pos = end + 1;
+            ++line;
+
+            if (row.empty() || '#' == row[0] || ';' == row[0])
+               continue;
+            if ('[' == row[0])
+            {
+               if (']' == row.back())
+                  section = trim(row.substr(1, row.size() - 2));
+               continue;
+            }
+
+            auto equal = row.find('=');
+            if (std::string_view::npos == equal)
+            {
+               fn(section, row, std::optional<std::string_view>(), line);
+               continue;
+            }
+            auto key = trim(row.substr(0, equal));
+            auto value = trim(row.substr(equal + 1));
+            if (2 <= value.size() && ('"' == value[0] || '\'' == value[0]) && value.back() == value[0])
+               value = value.substr(1, value.size() - 2);
+            if (!key.empty())
+               fn(section, key, std::optional<std::string_view>(value), line);
+         }
+      }
+
+      // what the args read from response files point into: the files and the args that had to be
+      // unquoted (or decoded, for wide CharTypes), or were moved into a view_parser. A deque never
+      // moves its elements.
+      template<typename CharType>
+      struct response_storage
+      {
+         std::vector<std::unique_ptr<mapped_file>> files;
+         std::deque<std::basic_string<CharType>> strings;
+         std::vector<std::shared_ptr<void const>> indexes; // replaced option indexes abbreviated names point into
+      };
+
+      // a small number per type, no RTTI needed
+      inline uint32_t next_type_id()
+      {
+         static std::atomic<uint32_t> next{ 0 };
+         return next++;
+      }
+
+      template<typename T>
+      uint32_t type_id()
+      {
+         static uint32_t const id = next_type_id();
+         return id;
+      }
+
+      // Converted values of one option, one node per type, pushed with a CAS: readers walk the list
+      // without a lock, and a node is never changed or freed while the chain lives. If two threads
+      // convert the same type at once, one node is kept and the other one dropped.
+      class typed_chain
+      {
+         struct node
+         {
+            virtual ~node() = default;
+            uint32_t type = 0;
+            node* next = nullptr;
+         };
+
+         template<typename T>
+         struct value_node : node
+         {
+            std::optional<T> value;
+         };
+
+         std::atomic<node*> head_{ nullptr };
+
+      public:
+         typed_chain() = default;
+         typed_chain(typed_chain const&) = delete;
+         typed_chain& operator=(typed_chain const&) = delete;
+         ~typed_chain() { clear(); }
+
+         // the value stored for Key, made with convert() (which gives a std::optional<T>) the first time
+         template<typename T, typename Key, typename Convert>
+         std::optional<T> const& get(Convert&& convert)
+         {
+            uint32_t const type = type_id<Key>();
+            node* seen = head_.load(std::memory_order_acquire);
+            for (node* n = seen; n; n = n->next)
+               if (type == n->type)
+                  return static_cast<value_node<T>*>(n)->value;
+
+            auto fresh = std::make_unique<value_node<T>>();
+            fresh->type = type;
+            fresh->value = convert();
+            fresh->next = seen;
+            while (!head_.compare_exchange_weak(fresh->next, fresh.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+               // only the nodes pushed since the last look are new
+               for (node* n = fresh->next; n != seen; n = n->next)
+                  if (type == n->type)
+                     return static_cast<value_node<T>*>(n)->value;
+               seen = fresh->next;
+            }
+            return fresh.release()->value;
+         }
+
+         void clear()
+         {
+            for (node* n = head_.exchange(nullptr); n;)
+               delete std::exchange(n, n->next);
+         }
+      };
+
+      // set when a registration outdates parser::names_, which the first lookup after rebuilds. The
+      // lookups are const and may run concurrently (parse_batch()), so one of them rebuilds under the
+      // mutex. Copies get their own mutex.
+      struct rebuild_flag
+      {
+         std::atomic<bool> dirty{ false };
+         std::mutex mutex;
+
+         rebuild_flag() = default;
+         rebuild_flag(rebuild_flag const& other) : dirty(other.dirty.load()) {}
+         rebuild_flag& operator=(rebuild_flag const& other)
+         {
+            dirty = other.dirty.load();
+            return *this;
+         }
+      };
+
+      // The ids of parser::intern() by name, hashed: open addressing over a power of two table kept at
+      // most half full. The slots hold ids only and name_of(id) gives the name, so the parser keeps the
+      // strings and copies of the table stay valid.
+      template<typename CharType, typename Allocator>
+      class id_table
+      {
+      public:
+         static constexpr uint32_t none = ~uint32_t(0);
+
+         explicit id_table(Allocator const& alloc = Allocator()) : slots_(alloc) {}
+
+         template<typename NameOf>
+         uint32_t find(std::basic_string_view<CharType> key, NameOf&& name_of) const
+         {
+            if (slots_.empty())
+               return none;
+            auto const mask = slots_.size() - 1;
+            auto slot = std::hash<std::basic_string_view<CharType>>()(key) & mask;
+            for (; none != slots_[slot]; slot = (slot + 1) & mask)
+               if (name_of(slots_[slot]) == key)
+                  return slots_[slot];
+            return none;
+         }
+
+         // id is not in the table yet
+         template<typename NameOf>
+         void insert(uint32_t id, NameOf&& name_of)
+         {
+            if (slots_.size() < 2 * (size_ + 1))
+            {
+               std::vector<uint32_t, Allocator> old(std::max<size_t>(16, 2 * slots_.size()), none, slots_.get_allocator());
+               old.swap(slots_);
+               for (auto kept : old)
+                  if (none != kept)
+                     place(kept, name_of(kept));
+            }
+            place(id, name_of(id));
+            ++size_;
+         }
+
+      private:
+         void place(uint32_t id, std::basic_string_view<CharType> name)
+         {
+            auto const mask = slots_.size() - 1;
+            auto slot = std::hash<std::basic_string_view<CharType>>()(name) & mask;
+            while (none != slots_[slot])
+               slot = (slot + 1) & mask;
+            slots_[slot] = id;
+         }
+
+         std::vector<uint32_t, Allocator> slots_;
+         size_t size_ = 0;
+      };
+
+      // parser::cached(): a chain per option handle, and per name for names without one. The
+      // handle chains are only added by parser::intern(). The name ones are pushed onto a bucket with a
+      // CAS, as the nodes of a typed_chain are, so readers of either kind take no lock. Copies and
+      // assignments start empty.
+      template<typename CharType>
+      struct typed_cache
+      {
+         struct named_chain
+         {
+            std::basic_string<CharType> key;
+            typed_chain chain;
+            named_chain* next = nullptr;
+         };
+
+         static constexpr size_t bucket_count = 64;
+
+         std::deque<typed_chain> handles;
+         typed_chain none; // for a handle of no option
+         std::atomic<named_chain*> buckets[bucket_count] = {};
+
+         typed_cache() = default;
+         typed_cache(typed_cache const& other) { grow(other.handles.size()); }
+         typed_cache& operator=(typed_cache const& other)
+         {
+            clear();
+            grow(other.handles.size());
+            return *this;
+         }
+         ~typed_cache() { clear(); }
+
+         void grow(size_t count)
+         {
+            while (handles.size() < count)
+               handles.emplace_back();
+         }
+
+         typed_chain& named(std::basic_string_view<CharType> key)
+         {
+            auto& head = buckets[std::hash<std::basic_string_view<CharType>>()(key) % bucket_count];
+            named_chain* seen = head.load(std::memory_order_acquire);
+            for (named_chain* n = seen; n; n = n->next)
+               if (n->key == key)
+                  return n->chain;
+
+            auto fresh = std::make_unique<named_chain>();
+            fresh->key = key;
+            fresh->next = seen;
+            while (!head.compare_exchange_weak(fresh->next, fresh.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+               // only the names pushed since the last look are new
+               for (named_chain* n = fresh->next; n != seen; n = n->next)
+                  if (n->key == key)
+                     return n->chain;
+               seen = fresh->next;
+            }
+            return fresh.release()->chain;
+         }
+
+         typed_chain& handle(uint32_t id)
+         {
+            return id < handles.size() ? handles[id] : none;
+         }
+
+         void clear()
+         {
+            for (auto& chain : handles)
+               chain.clear();
+            none.clear();
+            for (auto& head : buckets)
+               for (named_chain* n = head.exchange(nullptr); n;)
+                  delete std::exchange(n, n->next);
+         }
+      };
+   }
+
+   // in converted to the encoding of To: UTF-8 for 1 byte CharTypes, UTF-16 for 2 byte ones and
+   // UTF-32 otherwise, as in argh::transcode<char>(std::wstring_view(L"...")).
+   template<typename To, typename From>
+   std::basic_string<To> transcode(std::basic_string_view<From> in)
+   {
+      std::basic_string<To> out;
+      detail::append_transcoded<To>(out, in);
+      return out;
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   // Compile-time option schema.
+   // A schema lists the options a program knows about: the name (without dashes), whether it is a
+   // flag or a param, and an optional alias. Everything is built at compile time, including a hash
+   // table (collision free when a seed allows it) so recognizing an option in parse() is O(1):
+   //
+   //    static constexpr auto opts = argh::make_schema({
+   //       { "threads", argh::option_kind::param, "t" },
+   //       { "verbose", argh::option_kind::flag,  "v" },
+   //    });
+   //    argh::parser<> cmdl(opts);
+   //
+   // Aliases are stored and looked up under the option's name. The schema must outlive the parser.
+
+   enum class option_kind { param, flag };
+
+   template<typename CharType = char>
+   struct option_spec
+   {
+      std::basic_string_view<CharType> name;
+      option_kind kind = option_kind::param;
+      std::basic_string_view<CharType> alias = {};
+   };
+
+   namespace detail
+   {
+      constexpr size_t next_pow2(size_t n)
+      {
+         size_t p = 1;
+         while (p < n)
+            p <<= 1;
+         return p;
+      }
+
+      template<typename CharType>
+      constexpr uint32_t hash(std::basic_string_view<CharType> str, uint32_t seed)
+      {
+         uint32_t h = 2166136261u ^ seed; // FNV-1a
+         for (auto c : str)
+         {
+            h ^= static_cast<uint32_t>(c);
+            h *= 16777619u;
+         }
+         return h ^ (h >> 15);
+      }
+   }
+
+   template<typename CharType, size_t N>
+   class basic_schema
+   {
+      using Tstring_view = std::basic_string_view<CharType>;
+
+   public:
+      // names and aliases, at a load factor of at most 1/2
+      static constexpr size_t table_size = detail::next_pow2(4 * N);
+
+      constexpr explicit basic_schema(option_spec<CharType> const (&specs)[N])
+      {
+         for (size_t i = 0; i < N; ++i)
+            specs_[i] = specs[i];
+
+         // look for a seed without collisions, otherwise keep the last one and probe linearly
+         for (uint32_t seed = 0; seed < 64; ++seed)
+         {
+            seed_ = seed;
+            if (fill_table())
+               break;
+         }
+         sort_names();
+      }
+
+      constexpr size_t size() const { return N; }
+      constexpr option_spec<CharType> const& operator[](size_t ind) const { return specs_[ind]; }
+      constexpr option_spec<CharType> const* begin() const { return specs_; }
+      constexpr option_spec<CharType> const* end()   const { return specs_ + N; }
+
+      // returns the option named or aliased 'name' (without leading dashes), or nullptr
+      constexpr option_spec<CharType> const* find(Tstring_view name) const
+      {
+         for (auto slot = detail::hash(name, seed_) & (table_size - 1); 0 != slots_[slot]; slot = (slot + 1) & (table_size - 1))
+         {
+            auto const& spec = specs_[(slots_[slot] - 1) >> 1];
+            if (((slots_[slot] - 1) & 1 ? spec.alias : spec.name) == name)
+               return &spec;
+         }
+         return nullptr;
+      }
+
+      constexpr int index_of(Tstring_view name) const
+      {
+         auto spec = find(name);
+         return spec ? static_cast<int>(spec - specs_) : -1;
+      }
+
+      // the options in name order, so that a parser's option index is built without sorting them
+      constexpr option_spec<CharType> const& by_name(size_t ind) const { return specs_[order_[ind]]; }
+
+   private:
+      // slot values: 0 empty, otherwise 1 + 2 * spec index (+1 for the alias)
+      constexpr bool fill_table()
+      {
+         bool perfect = true;
+         for (auto& slot : slots_)
+            slot = 0;
+         for (size_t i = 0; i < 2 * N; ++i)
+         {
+            auto const& spec = specs_[i >> 1];
+            auto key = i & 1 ? spec.alias : spec.name;
+            if (key.empty())
+               continue;
+            auto slot = detail::hash(key, seed_) & (table_size - 1);
+            perfect = perfect && 0 == slots_[slot];
+            while (0 != slots_[slot])
+               slot = (slot + 1) & (table_size - 1);
+            slots_[slot] = static_cast<uint32_t>(i + 1);
+         }
+         return perfect;
+      }
+
+      // heapsort: std::sort is not constexpr before C++20
+      constexpr void sort_names()
+      {
+         for (size_t i = 0; i < N; ++i)
+            order_[i] = static_cast<uint32_t>(i);
+         auto sift = [this](size_t root, size_t end)
+         {
+            for (size_t child = 2 * root + 1; child < end; root = child, child = 2 * root + 1)
+            {
+               if (child + 1 < end && specs_[order_[child]].name < specs_[order_[child + 1]].name)
+                  ++child;
+               if (!(specs_[order_[root]].name < specs_[order_[child]].name))
+                  return;
+               auto const top = order_[root];
+               order_[root] = order_[child];
+               order_[child] = top;
+            }
+         };
+         for (size_t i = N / 2; i-- > 0;)
+            sift(i, N);
+         for (size_t end = N; end-- > 1;)
+         {
+            auto const top = order_[0];
+            order_[0] = order_[end];
+            order_[end] = top;
+            sift(0, end);
+         }
+      }
+
+      option_spec<CharType> specs_[N] = {};
+      uint32_t seed_ = 0;
+      uint32_t slots_[table_size] = {};
+      uint32_t order_[N] = {}; // spec indexes sorted by name
+   };
+
+   template<typename CharType = char, size_t N>
+   constexpr basic_schema<CharType, N> make_schema(option_spec<CharType> const (&specs)[N])
+   {
+      return basic_schema<CharType, N>(specs);
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   // Option index: the names a parser knows (registered params and schema options, not aliases) in a
+   // prefix trie, for exact and abbreviated lookups in O(name length).
+
+   // what an option name, maybe abbreviated, matches (see parser::match()). The views point into the
+   // parser's index and are valid until the next add_param(), add_params() or use_schema().
+   template<typename CharType = char>
+   struct option_match
+   {
+      enum status { none, exact, prefix, ambiguous };
+
+      status result = none;
+      std::basic_string_view<CharType> name;                    // exact and (unique) prefix: the known name
+      std::vector<std::basic_string_view<CharType>> candidates; // ambiguous: the known names it starts
+   };
+
+   namespace detail
+   {
+      // The trie lives in arrays: node i has the edges [nodes_[i].first_edge, nodes_[i + 1].first_edge),
+      // sorted by label, and the names are sorted so that the ones starting with the prefix of a node are
+      // the range [first, first + count). The node is a whole name if the first of them is that long.
+      template<typename CharType>
+      class prefix_trie
+      {
+         using Tstring_view = std::basic_string_view<CharType>;
+
+      public:
+         struct node
+         {
+            uint32_t first_edge;
+            uint32_t first;
+            uint32_t count;
+         };
+
+         struct lookup
+         {
+            typename option_match<CharType>::status result;
+            uint32_t first; // names_[first, first + count) start with the name
+            uint32_t count;
+         };
+
+         // names: (name, is a param) pairs, a name given twice is a param if one of them is. Sorted
+         // names are taken as they are.
+         explicit prefix_trie(std::vector<std::pair<Tstring_view, bool>> names)
+         {
+            if (!std::is_sorted(names.begin(), names.end()))
+               std::sort(names.begin(), names.end());
+            size_t chars = 0;
+            for (auto const& name : names)
+               chars += name.first.size();
+            pool_.reserve(chars);
+            for (auto const& name : names)
+            {
+               if (!names_.empty() && name.first == this->name(static_cast<uint32_t>(names_.size() - 1)))
+               {
+                  names_.back().param = names_.back().param || name.second;
+                  continue;
+               }
+               names_.push_back({ static_cast<uint32_t>(pool_.size()), static_cast<uint32_t>(name.first.size()), name.second });
+               pool_.append(name.first);
+            }
+
+            // breadth first, so the edges of a node are added together
+            std::vector<uint32_t> depths{ 0 };
+            nodes_.push_back({ 0, 0, static_cast<uint32_t>(names_.size()) });
+            for (uint32_t i = 0; i < nodes_.size(); ++i)
+            {
+               nodes_[i].first_edge = static_cast<uint32_t>(labels_.size());
+               auto const depth = depths[i];
+               auto ind = nodes_[i].first, last = ind + nodes_[i].count;
+               if (ind < last && depth == names_[ind].size)
+                  ++ind;
+               while (ind < last)
+               {
+                  auto const label = name(ind)[depth];
+                  auto const first = ind;
+                  while (ind < last && name(ind)[depth] == label)
+                     ++ind;
+                  labels_.push_back(label);
+                  children_.push_back(static_cast<uint32_t>(nodes_.size()));
+                  nodes_.push_back({ 0, first, ind - first });
+                  depths.push_back(depth + 1);
+               }
+            }
+            nodes_.push_back({ static_cast<uint32_t>(labels_.size()), 0, 0 }); // ends the edges of the last node
+         }
+
+         lookup find(Tstring_view str) const
+         {
+            auto const* found = walk(str);
+            if (!found || 0 == found->count)
+               return { option_match<CharType>::none, 0, 0 };
+            auto const& n = *found;
+            if (str.size() == names_[n.first].size)
+               return { option_match<CharType>::exact, n.first, 1 };
+            return { 1 == n.count ? option_match<CharType>::prefix : option_match<CharType>::ambiguous, n.first, n.count };
+         }
+
+         // every name starting with str (str itself included): names_[first, first + count), as a pair
+         std::pair<uint32_t, uint32_t> with_prefix(Tstring_view str) const
+         {
+            auto const* found = walk(str);
+            return found ? std::make_pair(found->first, found->count) : std::make_pair(uint32_t(0), uint32_t(0));
+         }
+
+         // whether str points into the name pool (an expanded abbreviation, say)
+         bool owns(Tstring_view str) const
+         {
+            std::less_equal<CharType const*> le;
+            return !str.empty() && le(pool_.data(), str.data()) && le(str.data() + str.size(), pool_.data() + pool_.size());
+         }
+
+         uint32_t size() const                 { return static_cast<uint32_t>(names_.size()); }
+         Tstring_view name(uint32_t ind) const { return Tstring_view(pool_.data() + names_[ind].offset, names_[ind].size); }
+         bool is_param(uint32_t ind) const     { return names_[ind].param; }
+
+      private:
+         struct entry
+         {
+            uint32_t offset;
+            uint32_t size;
+            bool param;
+         };
+
+         // the node str leads to, nullptr if no name starts with it
+         node const* walk(Tstring_view str) const
+         {
+            uint32_t i = 0;
+            for (auto c : str)
+            {
+               auto first = labels_.begin() + nodes_[i].first_edge, last = labels_.begin() + nodes_[i + 1].first_edge;
+               auto edge = std::lower_bound(first, last, c);
+               if (edge == last || *edge != c)
+                  return nullptr;
+               i = children_[edge - labels_.begin()];
+            }
+            return &nodes_[i];
+         }
+
+         std::basic_string<CharType> pool_;
+         std::vector<entry> names_;
+         std::vector<node> nodes_;        // the root first, plus one ending the edges
+         std::vector<CharType> labels_;   // edge labels
+         std::vector<uint32_t> children_; // the node each edge leads to
+      };
+   }
+
+   //////////////////////////////////////////////////////////////////////////
+   // Batch parsing (see parser::parse_batch()): many independent command lines, parsed with the
+   // options registered on one parser into one columnar result.
+
+   // an argv array and its size
+   template<typename CharType = char>
+   struct command_line
+   {
+      size_t argc = 0;
+      const CharType* const* argv = nullptr;
+   };
+
+   // a contiguous range of T
+   template<typename T>
+   class slice
+   {
+   public:
+      slice() = default;
+      slice(T const* first, T const* last) : first_(first), last_(last) {}
+
+      T const* begin() const { return first_; }
+      T const* end()   const { return last_;  }
+      size_t size()    const { return static_cast<size_t>(last_ - first_); }
+      bool empty()     const { return first_ == last_; }
+      T const& operator[](size_t ind) const { return first_[ind]; }
+
+   private:
+      T const* first_ = nullptr;
+      T const* last_ = nullptr;
+   };
+
+   // The flags, params and positional args of all the lines, each kind in one shared table, and per
+   // line offsets into the tables. Everything is a view into the argv strings (names given by a schema
+   // alias point into the schema, abbreviated ones into the parser's index, which the result keeps),
+   // which must outlive the result.
+   template<typename CharType = char>
+   class batch_result
+   {
+      using Tstring_view = std::basic_string_view<CharType>;
+
+   public:
+      using param_type = std::pair<Tstring_view, Tstring_view>;
+
+      // the results of one command line, with the accessors of parser.
+      // lookups scan the line's slice of the table: a command line is short.
+      class line
+      {
+      public:
+         slice<Tstring_view> flags()    const { return r_->slice_of(r_->flags_, r_->flag_offsets_, ind_);   }
+         slice<param_type>   params()   const { return r_->slice_of(r_->params_, r_->param_offsets_, ind_); }
+         slice<Tstring_view> pos_args() const { return r_->slice_of(r_->pos_args_, r_->pos_offsets_, ind_); }
+         size_t size()                  const { return pos_args().size(); }
+
+         bool operator[](Tstring_view name) const
+         {
+            auto flags = this->flags();
+            return std::find(flags.begin(), flags.end(), r_->canonical(name)) != flags.end();
+         }
+
+         Tstring_view operator[](size_t ind) const
+         {
+            auto args = pos_args();
+            return ind < args.size() ? args[ind] : Tstring_view();
+         }
+
+         // the value of the named param, the first one if it appeared more than once
+         std::optional<Tstring_view> param(Tstring_view name) const
+         {
+            auto params = this->params();
+            name = r_->canonical(name);
+            auto it = std::find_if(params.begin(), params.end(), [&](param_type const& p) { return p.first == name; });
+            if (it == params.end())
+               return std::nullopt;
+            return it->second;
+         }
+
+         template<typename T>
+         std::optional<T> try_get(Tstring_view name) const
+         {
+            if (auto value = param(name))
+               return detail::convert<T, CharType>(*value);
+            return std::nullopt;
+         }
+
+         template<typename T>
+         T get(Tstring_view name, T def_val) const
+         {
+            auto value = try_get<T>(name);
+            return value ? std::move(*value) : std::move(def_val);
+         }
+
+      private:
+         friend class batch_result;
+         line(batch_result const* r, size_t ind) : r_(r), ind_(ind) {}
+
+         batch_result const* r_;
+         size_t ind_;
+      };
+
+      size_t size() const { return pos_offsets_.size() - 1; }
+      line operator[](size_t ind) const { return line(this, ind); }
+
+      std::vector<Tstring_view> const& flags()    const { return flags_;    }
+      std::vector<param_type>   const& params()   const { return params_;   }
+      std::vector<Tstring_view> const& pos_args() const { return pos_args_; }
+
+   private:
+      template<typename, typename, typename>
+      friend class parser;
+
+      template<typename T>
+      static slice<T> slice_of(std::vector<T> const& table, std::vector<size_t> const& offsets, size_t ind)
+      {
+         return slice<T>(table.data() + offsets[ind], table.data() + offsets[ind + 1]);
+      }
+
+      Tstring_view canonical(Tstring_view name) const
+      {
+         name.remove_prefix(detail::leading_dashes(name));
+         auto spec = schema_ ? schema_find_(schema_, name) : nullptr;
+         return spec ? spec->name : name;
+      }
+
+      // closes the current line
+      void end_line()
+      {
+         flag_offsets_.push_back(flags_.size());
+         param_offsets_.push_back(params_.size());
+         pos_offsets_.push_back(pos_args_.size());
+      }
+
+      // appends the lines of other
+      void append(batch_result const& other)
+      {
+         auto shift = [](std::vector<size_t>& offsets, std::vector<size_t> const& more, size_t base)
+         {
+            for (size_t i = 1; i < more.size(); ++i)
+               offsets.push_back(base + more[i]);
+         };
+         shift(flag_offsets_, other.flag_offsets_, flags_.size());
+         shift(param_offsets_, other.param_offsets_, params_.size());
+         shift(pos_offsets_, other.pos_offsets_, pos_args_.size());
+         flags_.insert(flags_.end(), other.flags_.begin(), other.flags_.end());
+         params_.insert(params_.end(), other.params_.begin(), other.params_.end());
+         pos_args_.insert(pos_args_.end(), other.pos_args_.begin(), other.pos_args_.end());
+      }
+
+      // what step() reports, appended to the tables
+      struct sink
+      {
+         batch_result& r;
+         void at(size_t)                                 {}
+         void positional(Tstring_view arg)               { r.pos_args_.push_back(arg); }
+         void flag(Tstring_view name)                    { r.flags_.push_back(name); }
+         void param(Tstring_view name, Tstring_view val) { r.params_.emplace_back(name, val); }
+      };
+
+      std::vector<Tstring_view> flags_;
+      std::vector<param_type> params_;
+      std::vector<Tstring_view> pos_args_;
+      std::vector<size_t> flag_offsets_{ 0 };  // line i owns [offsets[i], offsets[i + 1])
+      std::vector<size_t> param_offsets_{ 0 };
+      std::vector<size_t> pos_offsets_{ 0 };
+      void const* schema_ = nullptr;
+      option_spec<CharType> const* (*schema_find_)(void const*, Tstring_view) = nullptr;
+      std::shared_ptr<void const> names_; // what ALLOW_ABBREVIATIONS names point into
+   };
+
+   //////////////////////////////////////////////////////////////////////////
+   // An immutable copy of a parser's results (see parser::freeze()) for reading from many threads.
+   // It is one relocatable blob: sorted tables of (offset, size) references into a string pool, the
+   // numbers convert() makes of each value, computed once, and the schema aliases, so no schema has
+   // to outlive it. The accessors are const and thread-safe without locks, and do not allocate for
+   // strings and arithmetic types. Hand it out with the shared_ptr freeze() returns; reloading is
+   // swapping in a new one.
+   //
+   // bytes() can be written to a file and load() maps it back, serving the accessors straight from the
+   // mapping. With hash_args() as the key, a cache hit skips tokenizing (and response files):
+   //
+   //    auto key = argh::hash_args(argc, argv);
+   //    auto opts = argh::snapshot<>::load("opts.cache", key);
+   //    if (!opts) { cmdl.parse(argc, argv, mode); opts = cmdl.freeze(key); opts->save("opts.cache"); }
+   //
+   // The values the parser falls back to, from the environment and config files, are frozen as params
+   // and the config flags as flags. The key only covers the args: include what else the parse depends
+   // on (response file contents, registrations, the bound variables, the config files) in it. Blobs are
+   // native endian and checked when loaded.
+
+   namespace detail
+   {
+      struct blob_ref
+      {
+         uint32_t offset; // in CharTypes, into the pool
+         uint32_t size;
+      };
+
+      struct blob_number
+      {
+         int64_t integer;
+         double real;
+         uint32_t has_integer;
+         uint32_t has_real;
+      };
+
+      // followed by the refs of the flags, param names, param values, positional args and (alias, name)
+      // pairs, the numbers of the param values and positional args, and the pool
+      struct blob_header
+      {
+         char magic[4];
+         uint32_t version;
+         uint32_t char_size;
+         uint32_t byte_order; // endian_marker as written
+         uint32_t flags, params, pos_args, aliases;
+         uint64_t key;
+         uint64_t pool_size;  // CharTypes
+         uint64_t size;       // bytes, header included
+      };
+
+      constexpr uint32_t blob_version = 1;
+      constexpr uint32_t endian_marker = 0x01020304;
+
+      template<typename CharType>
+      blob_number to_blob_number(std::basic_string_view<CharType> str)
+      {
+         auto integer = convert<long long, CharType>(str);
+         auto real = convert<double, CharType>(str);
+         return { integer ? *integer : 0, real ? *real : 0.0, integer.has_value(), real.has_value() };
+      }
+   }
+
+   // a hash of the command line, as the key of a saved snapshot (64 bit FNV-1a over the args, each one
+   // after its length, so no two lists of args are the same input)
+   template<typename CharType>
+   uint64_t hash_args(size_t argc, const CharType* const argv[])
+   {
+      uint64_t h = 14695981039346656037ull;
+      auto add = [&h](uint64_t unit) { h = (h ^ unit) * 1099511628211ull; };
+      for (size_t i = 0; i < argc; ++i)
+      {
+         uint64_t const length = std::char_traits<CharType>::length(argv[i]);
+         for (int byte = 0; byte < 8; ++byte)
+            add((length >> (8 * byte)) & 0xFF);
+         for (auto p = argv[i]; *p; ++p)
+            add(static_cast<std::make_unsigned_t<CharType>>(*p));
+      }
+      return h;
+   }
+
+   template<typename CharType = char>
+   class snapshot
+   {
+      using Tstring_view = std::basic_string_view<CharType>;
+
+   public:
+      // the strings of a table
+      class strings
+      {
+      public:
+         class iterator
+         {
+         public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type        = Tstring_view;
+            using difference_type   = std::ptrdiff_t;
+            using pointer           = void;
+            using reference         = Tstring_view;
+
+            iterator() = default;
+            iterator(CharType const* pool, detail::blob_ref const* ref) : pool_(pool), ref_(ref) {}
+
+            Tstring_view operator*() const { return Tstring_view(pool_ + ref_->offset, ref_->size); }
+            Tstring_view operator[](difference_type n) const { return *(*this + n); }
+            iterator& operator++()                 { ++ref_; return *this; }
+            iterator  operator++(int)              { auto it = *this; ++ref_; return it; }
+            iterator& operator--()                 { --ref_; return *this; }
+            iterator  operator--(int)              { auto it = *this; --ref_; return it; }
+            iterator& operator+=(difference_type n) { ref_ += n; return *this; }
+            iterator& operator-=(difference_type n) { ref_ -= n; return *this; }
+            iterator  operator+(difference_type n) const { return iterator(pool_, ref_ + n); }
+            iterator  operator-(difference_type n) const { return iterator(pool_, ref_ - n); }
+            difference_type operator-(iterator const& other) const { return ref_ - other.ref_; }
+            bool operator==(iterator const& other) const { return ref_ == other.ref_; }
+            bool operator!=(iterator const& other) const { return ref_ != other.ref_; }
+            bool operator<(iterator const& other)  const { return ref_ < other.ref_; }
+
+         private:
+            CharType const* pool_ = nullptr;
+            detail::blob_ref const* ref_ = nullptr;
+         };
+
+         strings() = default;
+         strings(CharType const* pool, detail::blob_ref const* first, detail::blob_ref const* last) : pool_(pool), first_(first), last_(last) {}
+
+         iterator begin() const { return iterator(pool_, first_); }
+         iterator end()   const { return iterator(pool_, last_);  }
+         size_t size()    const { return static_cast<size_t>(last_ - first_); }
+         bool empty()     const { return first_ == last_; }
+         Tstring_view operator[](size_t ind) const { return Tstring_view(pool_ + first_[ind].offset, first_[ind].size); }
+
+      private:
+         CharType const* pool_ = nullptr;
+         detail::blob_ref const* first_ = nullptr;
+         detail::blob_ref const* last_ = nullptr;
+      };
+
+      snapshot(snapshot const&) = delete; // the tables point into the blob
+      snapshot& operator=(snapshot const&) = delete;
+
+      // a snapshot saved with key, or nullptr if the file is missing, has another key or is not a valid blob
+      static std::shared_ptr<snapshot const> load(char const* path, uint64_t key)
+      {
+         std::shared_ptr<snapshot> loaded(new snapshot());
+         loaded->file_ = std::make_unique<detail::mapped_file>(path);
+         auto const contents = loaded->file_->contents();
+         if (!loaded->file_->is_open() || !loaded->open(contents.data(), contents.size()) || key != loaded->key())
+            return nullptr;
+         return loaded;
+      }
+
+      // writes bytes() to path
+      bool save(char const* path) const
+      {
+         std::FILE* file = std::fopen(path, "wb");
+         if (!file)
+            return false;
+         bool const written = header_->size == std::fwrite(data_, 1, header_->size, file);
+         return 0 == std::fclose(file) && written;
+      }
+
+      std::string_view bytes() const { return std::string_view(data_, header_->size); }
+      uint64_t key() const           { return header_->key; }
+
+      bool operator[](Tstring_view name) const
+      {
+         auto flags = this->flags();
+         return std::binary_search(flags.begin(), flags.end(), canonical(name));
+      }
+
+      Tstring_view operator[](size_t ind) const { return ind < size() ? pos_args()[ind] : Tstring_view(); }
+      size_t size() const { return header_->pos_args; }
+
+      // the value of the named param, the first one if it appeared more than once
+      std::optional<Tstring_view> param(Tstring_view name) const
+      {
+         auto ind = find(name);
+         if (npos == ind)
+            return std::nullopt;
+         return ref(param_values_[ind]);
+      }
+
+      // every value of the named param, in command line order
+      strings values(Tstring_view name) const
+      {
+         auto names = strings(pool_, param_names_, param_names_ + header_->params);
+         auto range = std::equal_range(names.begin(), names.end(), canonical(name));
+         auto first = param_values_ + (range.first - names.begin());
+         return strings(pool_, first, first + (range.second - range.first));
+      }
+
+      template<typename T>
+      std::optional<T> try_get(Tstring_view name) const
+      {
+         auto ind = find(name);
+         if (npos == ind)
+            return std::nullopt;
+         return typed<T>(ref(param_values_[ind]), param_numbers_[ind]);
+      }
+
+      template<typename T>
+      std::optional<T> try_get(size_t ind) const
+      {
+         if (size() <= ind)
+            return std::nullopt;
+         return typed<T>(ref(pos_args_[ind]), pos_numbers_[ind]);
+      }
+
+      template<typename T>
+      T get(Tstring_view name, T def_val) const
+      {
+         auto value = try_get<T>(name);
+         return value ? std::move(*value) : std::move(def_val);
+      }
+
+      template<typename T>
+      T get(size_t ind, T def_val) const
+      {
+         auto value = try_get<T>(ind);
+         return value ? std::move(*value) : std::move(def_val);
+      }
+
+      strings flags()    const { return strings(pool_, flags_, flags_ + header_->flags); }
+      strings pos_args() const { return strings(pool_, pos_args_, pos_args_ + header_->pos_args); }
+
+   private:
+      template<typename, typename, typename>
+      friend class parser;
+
+      static constexpr size_t npos = size_t(-1);
+
+      snapshot() = default;
+
+      // the offset of each part of a blob, in bytes
+      struct layout
+      {
+         size_t flags, param_names, param_values, pos_args, aliases, param_numbers, pos_numbers, pool, size;
+
+         layout(size_t flags_count, size_t params_count, size_t pos_count, size_t alias_count, size_t pool_size)
+         {
+            flags = sizeof(detail::blob_header);
+            param_names = flags + flags_count * sizeof(detail::blob_ref);
+            param_values = param_names + params_count * sizeof(detail::blob_ref);
+            pos_args = param_values + params_count * sizeof(detail::blob_ref);
+            aliases = pos_args + pos_count * sizeof(detail::blob_ref);
+            param_numbers = (aliases + 2 * alias_count * sizeof(detail::blob_ref) + 7) & ~size_t(7);
+            pos_numbers = param_numbers + params_count * sizeof(detail::blob_number);
+            pool = pos_numbers + pos_count * sizeof(detail::blob_number);
+            size = pool + pool_size * sizeof(CharType);
+         }
+      };
+
+      // points the tables into a blob after checking it
+      bool open(char const* data, size_t size)
+      {
+         if (size < sizeof(detail::blob_header) || 0 != reinterpret_cast<uintptr_t>(data) % alignof(detail::blob_number))
+            return false;
+         auto header = reinterpret_cast<detail::blob_header const*>(data);
+         if (0 != std::memcmp(header->magic, "argh", 4) || detail::blob_version != header->version
+            || sizeof(CharType) != header->char_size || detail::endian_marker != header->byte_order
+            || header->pool_size > size || size != header->size)
+            return false;
+         layout const at(header->flags, header->params, header->pos_args, header->aliases, static_cast<size_t>(header->pool_size));
+         if (at.size != size)
+            return false;
+
+         auto refs = reinterpret_cast<detail::blob_ref const*>(data + at.flags);
+         auto const ref_count = header->flags + 2 * size_t(header->params) + header->pos_args + 2 * size_t(header->aliases);
+         for (size_t i = 0; i < ref_count; ++i)
+         {
+            if (refs[i].offset > header->pool_size || refs[i].size > header->pool_size - refs[i].offset)
+               return false;
+         }
+
+         data_ = data;
+         header_ = header;
+         flags_ = refs;
+         param_names_ = reinterpret_cast<detail::blob_ref const*>(data + at.param_names);
+         param_values_ = reinterpret_cast<detail::blob_ref const*>(data + at.param_values);
+         pos_args_ = reinterpret_cast<detail::blob_ref const*>(data + at.pos_args);
+         aliases_ = reinterpret_cast<detail::blob_ref const*>(data + at.aliases);
+         param_numbers_ = reinterpret_cast<detail::blob_number const*>(data + at.param_numbers);
+         pos_numbers_ = reinterpret_cast<detail::blob_number const*>(data + at.pos_numbers);
+         pool_ = reinterpret_cast<CharType const*>(data + at.pool);
+         return true;
+      }
+
+      Tstring_view ref(detail::blob_ref const& r) const { return Tstring_view(pool_ + r.offset, r.size); }
+
+      // from the cached numbers when they give the answer convert() would, converted otherwise
+      template<typename T>
+      static std::optional<T> typed(Tstring_view str, detail::blob_number const& n)
+      {
+         if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool> && !detail::is_character_v<T>)
+         {
+            if (n.has_integer)
+            {
+               auto const v = n.integer;
+               bool fits;
+               if constexpr (std::is_signed_v<T>)
+                  fits = std::numeric_limits<T>::min() <= v && v <= std::numeric_limits<T>::max();
+               else
+                  fits = 0 <= v && static_cast<unsigned long long>(v) <= std::numeric_limits<T>::max();
+               if (fits)
+                  return static_cast<T>(v);
+            }
+         }
+         else if constexpr (std::is_same_v<T, double>)
+         {
+            if (!n.has_real)
+               return std::nullopt;
+            return n.real;
+         }
+         return detail::convert<T, CharType>(str);
+      }
+
+      size_t find(Tstring_view name) const
+      {
+         name = canonical(name);
+         auto names = strings(pool_, param_names_, param_names_ + header_->params);
+         auto it = std::lower_bound(names.begin(), names.end(), name);
+         return it != names.end() && *it == name ? static_cast<size_t>(it - names.begin()) : npos;
+      }
+
+      Tstring_view canonical(Tstring_view name) const
+      {
+         name.remove_prefix(detail::leading_dashes(name));
+         size_t first = 0, last = header_->aliases;
+         while (first < last) // aliases_ holds (alias, name) pairs sorted by alias
+         {
+            auto const mid = first + (last - first) / 2;
+            auto const alias = ref(aliases_[2 * mid]);
+            if (alias == name)
+               return ref(aliases_[2 * mid + 1]);
+            if (alias < name)
+               first = mid + 1;
+            else
+               last = mid;
+         }
+         return name;
+      }
+
+      std::string owned_; // the blob freeze() made, or
+      std::unique_ptr<detail::mapped_file> file_; // the one load() mapped
+      char const* data_ = nullptr;
+      detail::blob_header const* header_ = nullptr;
+      detail::blob_ref const* flags_ = nullptr;        // sorted
+      detail::blob_ref const* param_names_ = nullptr;  // sorted, repeated params once per value
+      detail::blob_ref const* param_values_ = nullptr; // param_values_[i] belongs to param_names_[i]
+      detail::blob_ref const* pos_args_ = nullptr;
+      detail::blob_ref const* aliases_ = nullptr;
+      detail::blob_number const* param_numbers_ = nullptr;
+      detail::blob_number const* pos_numbers_ = nullptr;
+      CharType const* pool_ = nullptr;
+   };
+
+#if defined(ARGH_ENABLE_STATS)
+   // what the last parse() did
+   struct parse_stats
+   {
+      size_t tokens = 0;
+      std::chrono::nanoseconds classify_time{};  // classification pass
+      std::chrono::nanoseconds insert_time{};    // state machine and container inserts
+      size_t number_probes = 0;                  // tokens that needed the numeric scan (leading '-')
+      size_t container_allocations = 0;          // made by the vectors, maps and sets of the parser
+      size_t string_allocations = 0;             // stored strings too long for their small buffer
+   };
+#endif
+
+   // The values of a repeated param in command line order (see parser::values()): the one params()
+   // holds, followed by its repeats. Iterators reference the parser's storage.
+   template<typename StringType, typename RepeatIterator>
+   class value_range
+   {
+   public:
+      class iterator
+      {
+      public:
+         using iterator_category = std::forward_iterator_tag;
+         using value_type        = StringType;
+         using difference_type   = std::ptrdiff_t;
+         using pointer           = StringType const*;
+         using reference         = StringType const&;
+
+         iterator() = default;
+         iterator(StringType const* first, RepeatIterator repeat) : first_(first), repeat_(repeat) {}
+
+         reference operator*()  const { return first_ ? *first_ : repeat_->second; }
+         pointer   operator->() const { return &**this; }
+         iterator& operator++()       { if (first_) first_ = nullptr; else ++repeat_; return *this; }
+         iterator  operator++(int)    { auto it = *this; ++*this; return it; }
+         bool operator==(iterator const& other) const { return first_ == other.first_ && repeat_ == other.repeat_; }
+         bool operator!=(iterator const& other) const { return !(*this == other); }
+
+      private:
+         StringType const* first_ = nullptr; // until it is passed
+         RepeatIterator repeat_{};
+      };
+
+      value_range() = default;
+      value_range(StringType const* first, RepeatIterator repeats_begin, RepeatIterator repeats_end)
+         : first_(first), repeats_begin_(repeats_begin), repeats_end_(repeats_end) {}
+
+      iterator begin() const { return iterator(first_, repeats_begin_); }
+      iterator end()   const { return iterator(nullptr, repeats_end_); }
+      bool empty()     const { return !first_; }
+      size_t size()    const { return first_ ? 1 + static_cast<size_t>(std::distance(repeats_begin_, repeats_end_)) : 0; }
+
+   private:
+      StringType const* first_ = nullptr;
+      RepeatIterator repeats_begin_{}, repeats_end_{};
+   };
+
+   // the output formats of parser::write_completions() and completion_script()
+   enum class shell { bash, zsh, fish };
+
+   // The completion function of program for sh, to be sourced (or installed where the shell looks for
+   // completions). On tab it runs "program __complete <shell> <cursor> <words...>", answered by
+   // parser::serve_completion(), and falls back to files when there is no candidate.
+   inline std::string completion_script(shell sh, std::string_view program)
+   {
+      std::string function = "_";
+      for (char c : program)
+         function += ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') ? c : '_';
+      function += "_argh_complete";
+      std::string const name(program);
+
+      switch (sh)
+      {
+      case shell::bash:
+         return function + "() {\n"
+            "   local IFS=$'\\n'\n"
+            "   COMPREPLY=( $(\"${COMP_WORDS[0]}\" __complete bash \"$COMP_CWORD\" \"${COMP_WORDS[@]}\" 2>/dev/null) )\n"
+            "}\n"
+            "complete -o default -F " + function + " " + name + "\n";
+      case shell::zsh:
+         return "#compdef " + name + "\n" + function + "() {\n"
+            "   local -a candidates\n"
+            "   candidates=( ${(f)\"$(\"${words[1]}\" __complete zsh $((CURRENT - 1)) \"${words[@]}\" 2>/dev/null)\"} )\n"
+            "   if (( ${#candidates} )); then _describe 'option' candidates; else _files; fi\n"
+            "}\n"
+            "compdef " + function + " " + name + "\n";
+      case shell::fish:
+      default:
+         return "function " + function + "\n"
+            "   set -l words (commandline -opc)\n"
+            "   $words[1] __complete fish (count $words) $words (commandline -ct) 2>/dev/null\n"
+            "end\n"
+            "complete -c " + name + " -a '(" + function + ")'\n";
+      }
+   }
+
+   // where parser::origin() found an option
+   enum class value_source { none, command_line, environment, config_file };
+
+   struct value_origin
+   {
+      value_source source = value_source::none;
+      std::string_view file; // for config_file: the path given to load_config(), and the line in it
+      uint32_t line = 0;
+   };
+
+   // What add_param() and parser::intern() return: the index of an interned option name. The parser
+   // resolves every handle once per parse(), so reading an option through its handle is an array read.
+   // A handle belongs to the parser that made it (and its copies).
+   struct option_handle
+   {
+      static constexpr uint32_t npos = ~uint32_t(0);
+      uint32_t id = npos;
+
+      explicit operator bool() const { return npos != id; }
+   };
+
+   // StringType is what the parser stores for positional args, flags and params.
+   // With the default std::basic_string every token is copied out of argv.
+   // With std::basic_string_view (see view_parser) nothing is copied: the results reference argv
+   // directly, so argv must outlive the parser.
+   // Storage is tree_storage (std::map and friends) or flat_storage (sorted vectors).
+   // Every container uses the allocator of StringType (see allocator_type). With std::pmr::basic_string
+   // (see pmr::parser) all the memory of a parser comes from the memory_resource it is constructed with.
+   template<typename CharType = char, typename StringType = std::basic_string<CharType>, typename Storage = tree_storage>
+   class parser
+   {
+	   using Tstring = std::basic_string<CharType, std::char_traits<CharType>, std::allocator<CharType>>;
+	   using Tstring_view = std::basic_string_view<CharType>;
+	   using Tistringstream = std::basic_istringstream<CharType, std::char_traits<CharType>, std::allocator<CharType>>;
+	   using Tostringstream = std::basic_ostringstream<CharType, std::char_traits<CharType>, std::allocator<CharType>>;
+
+   public:
+	  using string_type    = StringType;
+	  using allocator_type = typename detail::string_allocator<StringType>::type;
+	  using name_type      = std::basic_string<CharType, std::char_traits<CharType>, allocator_type>; // owned, for registered names
+	  using args_type      = std::vector<StringType, detail::rebind_alloc<detail::container_allocator<allocator_type>, StringType>>;
+	  using flags_type     = typename Storage::template multiset<StringType, detail::container_allocator<allocator_type>>;
+	  using params_type    = typename Storage::template map<StringType, StringType, detail::container_allocator<allocator_type>>;
+	  using registry_type  = typename Storage::template set<name_type, detail::container_allocator<allocator_type>>;
+	  using repeated_params_type = typename Storage::template multimap<StringType, StringType, detail::container_allocator<allocator_type>>;
+	  using values_type    = value_range<StringType, typename repeated_params_type::const_iterator>;
+
+	  parser() = default;
+
+      explicit parser(allocator_type const& alloc)
+         : args_(alloc), params_(alloc), repeated_params_(alloc), pos_args_(alloc), flags_(alloc), registeredParams_(alloc),
+           interned_(alloc), interned_index_(alloc), handle_values_(alloc), handle_state_(alloc)
+      {}
+
+      parser(std::initializer_list<CharType const* const> pre_reg_names, allocator_type const& alloc = allocator_type())
+         : parser(alloc)
+      {  add_params(pre_reg_names); }
+
+      template<size_t N>
+      parser(basic_schema<CharType, N> const& schema, allocator_type const& alloc = allocator_type())
+         : parser(alloc)
+      {  use_schema(schema); }
+
+      parser(const CharType* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION, allocator_type const& alloc = allocator_type())
+         : parser(alloc)
+      {  parse(argv, mode); }
+
+      parser(int argc, const CharType* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION, allocator_type const& alloc = allocator_type())
+         : parser(alloc)
+      {  parse(argc, argv, mode); }
+
+      allocator_type get_allocator() const { return allocator_type(args_.get_allocator()); }
+
+#if defined(ARGH_ENABLE_STATS)
+      parse_stats const& stats() const { return stats_; }
+#endif
+
+      option_handle add_param(Tstring_view name)
+	  {
+		  registeredParams_.emplace(trim_leading_dashes(name));
+		  names_dirty_.dirty = true; // the registry is sealed with the index
+		  return intern(name);
+	  }
+
+	  void add_params(std::initializer_list<CharType const* const> init_list)
+	  {
+		  for (auto& name : init_list)
+			  registeredParams_.emplace(trim_leading_dashes(name));
+		  names_dirty_.dirty = true;
+	  }
+
+	  // returns the handle of an option name (flag or param) without registering it. Interning a name
+	  // twice gives the same handle, schema aliases give the handle of the option name.
+	  option_handle intern(Tstring_view name)
+	  {
+		  auto key = canonical(trim_leading_dashes(name));
+		  auto id = find_interned(key);
+		  if (decltype(interned_index_)::none != id)
+			  return { id };
+
+		  interned_.emplace_back(key);
+		  interned_index_.insert(static_cast<uint32_t>(interned_.size() - 1), interned_name());
+		  handle_values_.resize(interned_.size());
+		  handle_state_.resize(interned_.size());
+		  cache_.grow(interned_.size());
+		  resolve(interned_.size() - 1);
+		  return { static_cast<uint32_t>(interned_.size() - 1) };
+	  }
+
+	  // recognize the options of a compile-time schema, in addition to the registered params.
+	  // the schema is referenced, not copied.
+	  template<size_t N>
+	  void use_schema(basic_schema<CharType, N> const& schema)
+	  {
+		  schema_ = &schema;
+		  schema_find_ = [](void const* s, Tstring_view name) { return static_cast<basic_schema<CharType, N> const*>(s)->find(name); };
+		  schema_specs_ = [](void const* s)
+		  {
+			  auto schema = static_cast<basic_schema<CharType, N> const*>(s);
+			  return slice<option_spec<CharType>>(schema->begin(), schema->end());
+		  };
+		  schema_by_name_ = [](void const* s, size_t ind) -> option_spec<CharType> const&
+		  {
+			  return static_cast<basic_schema<CharType, N> const*>(s)->by_name(ind);
+		  };
+		  names_dirty_.dirty = true;
+	  }
+
+	  // looks name (dashes are ignored) up among the registered params and the schema options:
+	  // an exact match, the unique known name it abbreviates, or the names it is ambiguous between.
+	  // Parsing with ALLOW_ABBREVIATIONS stores a --long option under the name it abbreviates and
+	  // leaves ambiguous ones as given, so match() on the flag and param names finds them.
+	  option_match<CharType> match(Tstring_view name) const
+	  {
+		  option_match<CharType> m;
+		  auto const* index = names();
+		  if (!index)
+			  return m;
+		  auto found = index->find(trim_leading_dashes(name));
+		  m.result = found.result;
+		  if (option_match<CharType>::ambiguous == found.result)
+		  {
+			  for (auto i = found.first; i < found.first + found.count; ++i)
+				  m.candidates.push_back(index->name(i));
+		  }
+		  else if (option_match<CharType>::none != found.result)
+			  m.name = index->name(found.first);
+		  return m;
+	  }
+
+      // Environment fallback: a param missing from the command line gets the value of the environment
+      // variable bound to it. parse() reads the variables once into a sorted table; the name and typed
+      // accessors (and handles) search it after the args, without allocating. params() and values()
+      // only hold the args. Values are taken as UTF-8 for wide CharTypes.
+      void bind_env(Tstring_view name, std::string_view variable)
+	  {
+		  env_bindings_.emplace_back(Tstring(trim_leading_dashes(name)), std::string(variable));
+	  }
+
+      // binds the params (registered or in the schema) without a binding of their own to prefix + the
+      // name in upper case with '-' as '_': "threads" is APP_THREADS after env_prefix("APP_").
+      void env_prefix(std::string_view prefix)
+	  {
+		  env_prefix_ = std::string(prefix);
+	  }
+
+      // Reads the entries of an INI file (UTF-8, see detail::tokenize_config()) in one pass over the
+      // mapped file. "[net]" then "port = 80" gives the param "net.port", a "key" line without a value is
+      // a flag. Params missing from argv and the environment take their value from here, and flags are
+      // set by either; a file loaded later wins over an earlier one, as a later line does over an earlier
+      // one. A view_parser<char> keeps the file mapped and its values point into it. Unlike the results,
+      // the entries are kept by parse() and reset(), until clear_config(). Returns false if path cannot
+      // be read.
+      bool load_config(Tstring_view path)
+	  {
+		  auto file = detail::open_response_file(path);
+		  if (!file->is_open())
+			  return false;
+		  if (!config_store_)
+			  config_store_ = std::make_shared<detail::response_storage<CharType>>();
+
+		  auto const index = static_cast<uint32_t>(config_paths_.size());
+		  config_paths_.push_back(transcode<char>(path));
+		  Tstring key;
+		  detail::tokenize_config(file->contents(), [&](std::string_view section, std::string_view name, std::optional<std::string_view> value, uint32_t line)
+		  {
+			  key.clear();
+			  detail::append_transcoded<CharType>(key, section);
+			  if (!section.empty())
+				  key += CharType('.');
+			  detail::append_transcoded<CharType>(key, name);
+			  config_.push_back({ Tstring(canonical(trim_leading_dashes(key))), value ? config_value(*value) : StringType(), !value, index, line });
+		  });
+		  if constexpr (std::is_same_v<CharType, char> && std::is_same_v<StringType, Tstring_view>)
+			  config_store_->files.push_back(std::move(file));
+
+		  // by key, the latest entry first, which is the one kept
+		  std::sort(config_.begin(), config_.end(), [](config_entry const& a, config_entry const& b)
+		  {
+			  return a.key != b.key ? a.key < b.key : a.file != b.file ? a.file > b.file : a.line > b.line;
+		  });
+		  config_.erase(std::unique(config_.begin(), config_.end(), [](config_entry const& a, config_entry const& b) { return a.key == b.key; }), config_.end());
+
+		  cache_.clear();
+		  resolve_handles();
+		  return true;
+	  }
+
+      void clear_config()
+	  {
+		  config_.clear();
+		  config_store_.reset();
+		  config_paths_.clear();
+		  cache_.clear();
+		  resolve_handles();
+	  }
+
+      // where the value of a flag or param comes from: argv, the environment or a config file (in this
+      // order of precedence), none if it is missing
+      value_origin origin(Tstring_view name) const
+	  {
+		  auto key = canonical(trim_leading_dashes(name));
+		  finish();
+		  if (flags_.end() != flags_.find(key) || params_.end() != params_.find(key))
+			  return { value_source::command_line, {}, 0 };
+		  if (find_env(key))
+			  return { value_source::environment, {}, 0 };
+		  if (auto entry = find_config(key))
+			  return { value_source::config_file, config_paths_[entry->file], entry->line };
+		  return {};
+	  }
+
+      //////////////////////////////////////////////////////////////////////////
+      // Tab completion, from the option index alone: nothing is parsed or stored, a lookup costs a walk
+      // down the prefix trie plus the candidates (rebuilt once after a batch of registrations, see names()).
+      // Each keypress runs the program again, so the setup counts too: a schema's options come sorted
+      // by name from compile time and are indexed in one pass, where add_param() pays per option.
+
+      // calls fn(dashes, name, is_param) for each option that completes the word argv[cursor] (an empty
+      // word if cursor == argc), in name order; dashes are those of the word. Only a word that is an
+      // option ("-", "--v", not "-5") has candidates; the value after '=' does not, nor does
+      // argv[0]: the shell completes files then.
+      template<typename Fn>
+      void complete(size_t argc, const CharType* const argv[], size_t cursor, Fn&& fn) const
+	  {
+		  auto const* index = names();
+		  if (!index || 0 == cursor || argc < cursor)
+			  return;
+		  Tstring_view word = cursor < argc ? Tstring_view(argv[cursor], detail::length(argv[cursor])) : Tstring_view();
+		  auto const tok = detail::classify<CharType>(word, true);
+		  if (!tok.option || detail::token_info::npos != tok.equal)
+			  return;
+		  // unlike in a parse, "-" and "--" are the dashes of an option still to be typed
+		  size_t const dashes = Tstring_view::npos == word.find_first_not_of(CharType('-')) ? word.size() : tok.dashes;
+		  auto const range = index->with_prefix(word.substr(dashes));
+		  for (uint32_t i = range.first; i < range.first + range.second; ++i)
+			  fn(word.substr(0, dashes), index->name(i), index->is_param(i));
+	  }
+
+      // the candidates of complete(), one per line as the scripts of completion_script() read them:
+      // bare for bash, "name:takes a value" for the params (':' escaped) with zsh, and a tab for fish
+      void write_completions(std::basic_ostream<CharType>& out, shell sh, size_t argc, const CharType* const argv[], size_t cursor) const
+	  {
+		  auto put = [&](std::string_view text)
+		  {
+			  for (char c : text)
+				  out << CharType(c);
+		  };
+		  complete(argc, argv, cursor, [&](Tstring_view dashes, Tstring_view name, bool param)
+		  {
+			  out << dashes;
+			  if (shell::zsh == sh)
+			  {
+				  for (auto c : name)
+				  {
+					  if (CharType(':') == c || CharType('\\') == c)
+						  out << CharType('\\');
+					  out << c;
+				  }
+				  if (param)
+					  put(":takes a value");
+			  }
+			  else
+			  {
+				  out << name;
+				  if (shell::fish == sh && param)
+					  put("\ttakes a value");
+			  }
+			  out << CharType('\n');
+		  });
+	  }
+
+      // Answers the completion request of a completion_script() script, to be called first thing in
+      // main(): "prog __complete <shell> <cursor> <words...>" writes the candidates for the word at
+      // cursor in words (words[0] being the program) and returns true. Any other argv returns false.
+      bool serve_completion(size_t argc, const CharType* const argv[], std::basic_ostream<CharType>& out) const
+	  {
+		  auto is = [](CharType const* arg, std::string_view literal)
+		  {
+			  Tstring_view word(arg, detail::length(arg));
+			  return std::equal(word.begin(), word.end(), literal.begin(), literal.end(), [](CharType a, char b) { return a == CharType(b); });
+		  };
+		  if (argc < 4 || !is(argv[1], "__complete"))
+			  return false;
+
+		  shell sh = is(argv[2], "zsh") ? shell::zsh : is(argv[2], "fish") ? shell::fish : shell::bash;
+		  auto cursor = detail::convert<size_t, CharType>(Tstring_view(argv[3], detail::length(argv[3])));
+		  if (cursor)
+			  write_completions(out, sh, argc - 4, argv + 4, *cursor);
+		  return true;
+	  }
+
+	  bool serve_completion(int argc, const CharType* const argv[], std::basic_ostream<CharType>& out) const
+	  {
+		  return serve_completion(static_cast<size_t>(argc), argv, out);
+	  }
+
+      // Streams argv as events instead of storing it: visitor.on_positional(arg), visitor.on_flag(name)
+      // and visitor.on_param(name, value) are called in command line order, decided by the rules of
+      // parse() for mode (LAZY_PARSE aside). Each arg is classified once and only the current and the
+      // next one are kept, so memory does not grow with argc, response files included. The views are
+      // into argv, or only valid during the call for args read from response files. The parser's
+      // results are left alone.
+      template<typename Visitor>
+      void visit(size_t argc, const CharType* const argv[], Visitor&& visitor, int mode = PREFER_FLAG_FOR_UNREG_OPTION) const
+	  {
+		  struct sink
+		  {
+			  Visitor& v;
+			  void at(size_t)                                 {}
+			  void positional(Tstring_view arg)               { v.on_positional(arg); }
+			  void flag(Tstring_view name)                    { v.on_flag(name); }
+			  void param(Tstring_view name, Tstring_view val) { v.on_param(name, val); }
+		  } s{ visitor };
+
+		  stepper<sink> steps(*this, mode, s);
+		  for (size_t i = 0; i < argc; ++i)
+		  {
+			  Tstring_view arg(argv[i], detail::length(argv[i]));
+			  if (mode & EXPAND_RESPONSE_FILES)
+				  push_expanded(steps, arg, false, 0);
+			  else
+				  steps.push(arg);
+		  }
+		  steps.end();
+	  }
+
+	  // argv ends with a nullptr
+	  template<typename Visitor>
+	  void visit(const CharType* const argv[], Visitor&& visitor, int mode = PREFER_FLAG_FOR_UNREG_OPTION) const
+	  {
+		  size_t argc = 0;
+		  while (argv[argc])
+			  ++argc;
+		  visit(argc, argv, std::forward<Visitor>(visitor), mode);
+	  }
+
+      void parse(const CharType* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION)
+	  {
+		  int argc = 0;
+		  for (auto argvp = argv; *argvp; ++argc, ++argvp);
+		  parse(argc, argv, mode);
+	  }
+
+	  void parse(int argc, const CharType* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION)
+	  {
+		  parse(static_cast<size_t>(argc), argv, mode);
+	  }
+
+	  void parse(size_t argc, const CharType* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION);
+
+	  // parse() with a mode fixed at compile time, see fixed_mode. The runtime parse() above dispatches
+	  // the common modes to these.
+	  template<int M>
+	  void parse(const CharType* const argv[])
+	  {
+		  size_t argc = 0;
+		  while (argv[argc])
+			  ++argc;
+		  parse_argv(argc, argv, fixed_mode<M>());
+	  }
+
+	  template<int M>
+	  void parse(int argc, const CharType* const argv[])
+	  {
+		  parse_argv(static_cast<size_t>(argc), argv, fixed_mode<M>());
+	  }
+
+	  template<int M>
+	  void parse(size_t argc, const CharType* const argv[])
+	  {
+		  parse_argv(argc, argv, fixed_mode<M>());
+	  }
+
+	  // parses strings the caller owns. They are moved into the parser and, when they become a
+	  // positional arg or the value of a param ("-n value", not "--n=value"), moved on into the
+	  // results, so each of them is allocated once. A view_parser keeps them alive itself.
+	  void parse(std::vector<Tstring>&& args, int mode = PREFER_FLAG_FOR_UNREG_OPTION)
+	  {
+		  parse<std::vector<Tstring>>(std::move(args), mode);
+	  }
+
+	  // any range of strings or views; the elements are moved from if args is an rvalue of StringType
+	  // (Tstring for a view_parser) elements, copied otherwise
+	  template<typename Range, typename = std::enable_if_t<detail::is_string_range_v<Range, CharType>>>
+	  void parse(Range&& args, int mode = PREFER_FLAG_FOR_UNREG_OPTION);
+
+      // parse() adds to the results of earlier calls. reset() forgets them but keeps the registered
+      // params, the schema and the capacity of the vectors (and of flat_storage tables), so a parser
+      // reused with reparse() stops allocating once it has seen its largest command line, given
+      // flat_storage and views or short strings. tree_storage frees its nodes, and memory from a
+      // monotonic arena is only released with the arena.
+      void reset()
+	  {
+		  cache_.clear();
+		  env_.clear();
+		  tokens_.clear();
+		  args_.clear();
+		  params_.clear();
+		  repeated_params_.clear();
+		  pos_args_.clear();
+		  flags_.clear();
+		  responses_.reset();
+		  pending_ = false;
+		  feeding_ = feed_held_ = false;
+		  resolve_handles();
+	  }
+
+      void reparse(const CharType* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION)
+	  {
+		  reset();
+		  parse(argv, mode);
+	  }
+
+	  void reparse(int argc, const CharType* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION)
+	  {
+		  reset();
+		  parse(argc, argv, mode);
+	  }
+
+	  void reparse(size_t argc, const CharType* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION)
+	  {
+		  reset();
+		  parse(argc, argv, mode);
+	  }
+
+      // Parses count independent command lines with the params and schema of this parser, which is
+      // only read: any number of threads may share it. The lines are spread over 'threads' threads
+      // (0: one per hardware thread), which take chunks of lines from a shared counter as they go,
+      // so a thread that is done early takes more. The results of this parser are not touched.
+      batch_result<CharType> parse_batch(command_line<CharType> const* lines, size_t count,
+                                         int mode = PREFER_FLAG_FOR_UNREG_OPTION, unsigned threads = 0) const;
+
+      batch_result<CharType> parse_batch(std::vector<command_line<CharType>> const& lines,
+                                         int mode = PREFER_FLAG_FOR_UNREG_OPTION, unsigned threads = 0) const
+	  {
+		  return parse_batch(lines.data(), lines.size(), mode, threads);
+	  }
+
+      // LAZY_PARSE: parse() keeps the args and the mode and classifies nothing. An accessor looking for
+      // a flag, a param or the positional arg at some index runs the state machine only until it
+      // appears (or the args run out), and the results are kept, so the answers are those of an eager
+      // parse(). Accessors that need everything (flags(), params(), size(), values()...) finish the
+      // parse first, as does finish(). Until finished, const accessors of a lazy parser modify it and
+      // must not run concurrently.
+      void finish() const
+	  {
+		  if (pending_)
+			  resume(nullptr, nullptr, 0);
+		  if (feeding_)
+			  end_feed();
+	  }
+
+      // Incremental parse, for args that come one at a time (over a pipe, say): feed(arg) decides the
+      // arg fed before it, which needed arg as its lookahead, and holds arg until the next feed() or
+      // finish(). Only that arg is kept (copied: arg need not outlive the call), so memory grows with
+      // the results alone, but a view_parser keeps every arg for the views into them. What is decided
+      // is there at once for the name and index accessors; finish(), or an accessor that needs
+      // everything (flags(), params(), size()...), decides the held arg and seals the results, and
+      // handles are resolved and cached() values dropped then. Like parse(), a new feed() after that
+      // adds to the results. mode is that of the first feed(), where EXPAND_RESPONSE_FILES and
+      // LAZY_PARSE do not apply.
+      void feed(Tstring_view arg, int mode = PREFER_FLAG_FOR_UNREG_OPTION)
+	  {
+		  if (!feeding_)
+		  {
+			  assert(valid_mode(mode));
+			  detail::seal(registeredParams_);
+			  finish(); // a lazy parse before needs its args
+			  cache_.clear();
+			  read_env();
+			  feeding_ = true;
+			  feed_held_ = false;
+			  feed_mode_ = mode & ~(EXPAND_RESPONSE_FILES | LAZY_PARSE);
+		  }
+
+		  if constexpr (std::is_same_v<StringType, Tstring_view>)
+		  {
+			  detail::response_storage<CharType> unused;
+			  arg = arg_storage(unused).strings.emplace_back(arg);
+		  }
+		  auto const tok = detail::classify<CharType>(arg, !(feed_mode_ & NO_SPLIT_ON_EQUALSIGN));
+		  store_sink sink{ *this };
+		  if (feed_held_ && step(Tstring_view(feed_arg_), feed_tok_, &arg, &tok, feed_mode_, sink))
+		  {
+			  feed_held_ = false; // arg was the value of the held one
+			  return;
+		  }
+
+		  if constexpr (std::is_same_v<StringType, Tstring_view>)
+			  feed_arg_ = arg;
+		  else
+			  feed_arg_.assign(arg.data(), arg.size()); // reuses the capacity
+		  feed_tok_ = tok;
+		  feed_held_ = true;
+	  }
+
+      flags_type              const& flags()    const { finish(); return flags_;    }
+      params_type             const& params()   const { finish(); return params_;   }
+      args_type               const& pos_args() const { finish(); return pos_args_; }
+
+      // begin() and end() for using range-for over positional args.
+      typename args_type::const_iterator begin()  const { finish(); return pos_args_.cbegin(); }
+      typename args_type::const_iterator end()    const { finish(); return pos_args_.cend();   }
+      size_t size()                                 const { finish(); return pos_args_.size();   }
+
+      // an immutable copy of the results for concurrent readers, see snapshot. key is stored with it for load().
+      std::shared_ptr<snapshot<CharType> const> freeze(uint64_t key = 0) const;
+
+      //////////////////////////////////////////////////////////////////////////
+      // Name based accessors take a Tstring_view (a literal, a string or a view all bind to it).
+      // Dash trimming and the lookups work on the view, so queries do not allocate.
+
+      // flag (boolean) accessors: return true if the flag appeared, otherwise false.
+      bool operator[](Tstring_view name) const
+	  {
+		  return got_flag(name);
+	  }
+
+      bool operator[](option_handle handle) const
+	  {
+		  finish();
+		  return handle.id < handle_state_.size() && (handle_state_[handle.id] & seen_flag);
+	  }
+
+      // multiple flag (boolean) accessors: return true if at least one of the flag appeared, otherwise false.
+      bool operator[](std::initializer_list<CharType const* const> init_list) const
+	  {
+		  return std::any_of(init_list.begin(), init_list.end(), [&](CharType const* const name) { return got_flag(name); });
+	  }
+
+	  // returns positional arg string by order. Like argv[] but without the options
+	  StringType const& operator[](size_t ind) const
+	  {
+		  if (has_positional(ind))
+			  return pos_args_[ind];
+		  return empty_;
+	  }
+
+      // returns a std::istream that can be used to convert a positional arg to a typed value.
+      Tistringstream operator()(size_t ind) const
+	  {
+		  if (!has_positional(ind))
+			  return bad_stream();
+
+		  return make_stream(pos_args_[ind]);
+	  }
+
+      // same as above, but with a default value in case the arg is missing (index out of range).
+      template<typename T>
+      Tistringstream operator()(size_t ind, T&& def_val) const
+	  {
+		  if (!has_positional(ind))
+		  {
+			  Tostringstream ostr;
+			  ostr.precision(std::numeric_limits<long double>::max_digits10);
+			  ostr << def_val;
+			  return Tistringstream(ostr.str());
+		  }
+
+		  return make_stream(pos_args_[ind]);
+	  }
+
+      // parameter accessors, give a name get an std::istream that can be used to convert to a typed value.
+      // call .str() on result to get as string
+      Tistringstream operator()(Tstring_view name) const
+	  {
+		  if (auto value = find_param(name))
+			  return make_stream(*value);
+		  return bad_stream();
+	  }
+
+      Tistringstream operator()(option_handle handle) const
+	  {
+		  if (auto value = find_param(handle))
+			  return make_stream(*value);
+		  return bad_stream();
+	  }
+
+      // accessor for a parameter with multiple names, give a list of names, get an std::istream that can be used to convert to a typed value.
+      // call .str() on result to get as string
+      // returns the first value in the list to be found.
+      Tistringstream operator()(std::initializer_list<CharType const* const> init_list) const
+	  {
+		  for (auto& name : init_list)
+		  {
+			  if (auto value = find_param(name))
+				  return make_stream(*value);
+		  }
+		  return bad_stream();
+	  }
+
+      // same as above, but with a default value in case the param was missing.
+      // Non-string def_val types must have an operator<<() (output stream operator)
+      // If T only has an input stream operator, pass the string version of the type as in "3" instead of 3.
+      template<typename T>
+      Tistringstream operator()(Tstring_view name, T&& def_val) const
+	  {
+		  if (auto value = find_param(name))
+			  return make_stream(*value);
+
+		  Tostringstream ostr;
+		  ostr.precision(std::numeric_limits<long double>::max_digits10);
+		  ostr << def_val;
+		  return Tistringstream(ostr.str()); // use default
+	  }
+
+      // same as above but for a list of names. returns the first value to be found.
+      template<typename T>
+      Tistringstream operator()(std::initializer_list<CharType const* const> init_list, T&& def_val) const
+	  {
+		  for (auto& name : init_list)
+		  {
+			  if (auto value = find_param(name))
+				  return make_stream(*value);
+		  }
+		  Tostringstream ostr;
+		  ostr.precision(std::numeric_limits<long double>::max_digits10);
+		  ostr << def_val;
+		  return Tistringstream(ostr.str()); // use default
+	  }
+
+      //////////////////////////////////////////////////////////////////////////
+      // Typed accessors: convert a param or positional arg to T directly (see detail::convert()),
+      // without constructing a stream for the common types.
+      // try_get() returns an empty optional if the arg is missing or cannot be converted,
+      // get() returns def_val in that case, as-is.
+
+      template<typename T>
+      std::optional<T> try_get(Tstring_view name) const
+	  {
+		  if (auto value = find_param(name))
+			  return detail::convert<T, CharType>(*value);
+		  return std::nullopt;
+	  }
+
+      template<typename T>
+      std::optional<T> try_get(option_handle handle) const
+	  {
+		  if (auto value = find_param(handle))
+			  return detail::convert<T, CharType>(*value);
+		  return std::nullopt;
+	  }
+
+      template<typename T>
+      std::optional<T> try_get(size_t ind) const
+	  {
+		  if (has_positional(ind))
+			  return detail::convert<T, CharType>(pos_args_[ind]);
+		  return std::nullopt;
+	  }
+
+      template<typename T>
+      T get(Tstring_view name, T def_val) const
+	  {
+		  auto value = try_get<T>(name);
+		  return value ? std::move(*value) : std::move(def_val);
+	  }
+
+      template<typename T>
+      T get(option_handle handle, T def_val) const
+	  {
+		  auto value = try_get<T>(handle);
+		  return value ? std::move(*value) : std::move(def_val);
+	  }
+
+      template<typename T>
+      T get(size_t ind, T def_val) const
+	  {
+		  auto value = try_get<T>(ind);
+		  return value ? std::move(*value) : std::move(def_val);
+	  }
+
+      // a literal default gives a string, not a pointer
+      Tstring get(Tstring_view name, CharType const* def_val) const   { return get<Tstring>(name, def_val);   }
+      Tstring get(option_handle handle, CharType const* def_val) const { return get<Tstring>(handle, def_val); }
+      Tstring get(size_t ind, CharType const* def_val) const           { return get<Tstring>(ind, def_val);    }
+
+      // Memoized typed accessors: try_get() and get() converting once per param and T. Later calls
+      // return the kept value by pointer (nullptr if missing or not convertible) or, given def_val, a
+      // copy of it, def_val when there is none; only the conversion is kept, never the default.
+      // Concurrent readers may share the parser (once a LAZY_PARSE is finished). parse(), reset() and
+      // assignments drop the values.
+      template<typename T>
+      T const* cached(option_handle handle) const
+	  {
+		  auto& value = cache_.handle(handle.id).template get<T, T>([&] { return try_get<T>(handle); });
+		  return value ? &*value : nullptr;
+	  }
+
+      template<typename T>
+      T const* cached(Tstring_view name) const
+	  {
+		  auto& value = cache_chain(name).template get<T, T>([&] { return try_get<T>(name); });
+		  return value ? &*value : nullptr;
+	  }
+
+      template<typename T>
+      T cached(option_handle handle, T def_val) const
+	  {
+		  auto value = cached<T>(handle);
+		  return value ? *value : std::move(def_val);
+	  }
+
+      template<typename T>
+      T cached(Tstring_view name, T def_val) const
+	  {
+		  auto value = cached<T>(name);
+		  return value ? *value : std::move(def_val);
+	  }
+
+      // every value of a param that may be repeated (-I a -I b), in command line order, without copies.
+      // params() and the single value accessors keep the first one.
+      values_type values(Tstring_view name) const
+	  {
+		  finish();
+		  auto first = find_param(name);
+		  if (!first)
+			  return values_type();
+		  auto repeats = repeated_params_.equal_range(canonical(trim_leading_dashes(name)));
+		  return values_type(first, repeats.first, repeats.second);
+	  }
+
+      //////////////////////////////////////////////////////////////////////////
+      // UTF-8 accessors: a param or positional arg in UTF-8, converted from the CharType encoding (see
+      // argh::transcode()) only for the value asked for. transcoded<To>() is the same for UTF-16/UTF-32.
+      // Return an empty optional if the arg is missing.
+
+      std::optional<std::string> utf8(Tstring_view name)    const { return transcoded<char>(name);   }
+      std::optional<std::string> utf8(option_handle handle) const { return transcoded<char>(handle); }
+      std::optional<std::string> utf8(size_t ind)           const { return transcoded<char>(ind);    }
+
+      template<typename To>
+      std::optional<std::basic_string<To>> transcoded(Tstring_view name) const
+	  {
+		  if (auto value = find_param(name))
+			  return transcode<To>(Tstring_view(*value));
+		  return std::nullopt;
+	  }
+
+      template<typename To>
+      std::optional<std::basic_string<To>> transcoded(option_handle handle) const
+	  {
+		  if (auto value = find_param(handle))
+			  return transcode<To>(Tstring_view(*value));
+		  return std::nullopt;
+	  }
+
+      template<typename To>
+      std::optional<std::basic_string<To>> transcoded(size_t ind) const
+	  {
+		  if (has_positional(ind))
+			  return transcode<To>(Tstring_view(pos_args_[ind]));
+		  return std::nullopt;
+	  }
+
+   private:
+      template<typename, typename, typename>
+      friend class command_tree;
+
+      // the cached() values of name: those of its handle if it is interned
+      detail::typed_chain& cache_chain(Tstring_view name) const
+	  {
+		  auto key = canonical(trim_leading_dashes(name));
+		  auto id = find_interned(key);
+		  if (decltype(interned_index_)::none != id)
+			  return cache_.handle(id);
+		  return cache_.named(key);
+	  }
+
+      // the handle id of an interned name, id_table::none if not interned
+      uint32_t find_interned(Tstring_view key) const
+	  {
+		  return interned_index_.find(key, interned_name());
+	  }
+
+      auto interned_name() const
+	  {
+		  return [this](uint32_t id) { return Tstring_view(interned_[id]); };
+	  }
+
+      Tistringstream bad_stream() const
+	  {
+		  Tistringstream bad;
+		  bad.setstate(std::ios_base::failbit);
+		  return bad;
+	  }
+
+      static Tistringstream make_stream(Tstring const& str)
+	  {
+		  return Tistringstream(str);
+	  }
+
+      static Tistringstream make_stream(Tstring_view str)
+	  {
+		  return Tistringstream(Tstring(str));
+	  }
+
+	  // JB: added the '/' special case
+	  // returns a sub-view of name, no copy is made.
+      static Tstring_view trim_leading_dashes(Tstring_view name)
+	  {
+		  return name.substr(detail::leading_dashes(name));
+	  }
+
+      bool got_flag(Tstring_view name) const
+	  {
+		  auto key = canonical(trim_leading_dashes(name));
+		  return flags_.end() != flags_.find(key) || (pending_ && resume(&key, nullptr, 0)) || config_flag(key);
+	  }
+
+      // returns the value of the named param or nullptr if it is missing
+      StringType const* find_param(Tstring_view name) const
+	  {
+		  auto key = canonical(trim_leading_dashes(name));
+		  auto optIt = params_.find(key);
+		  if (params_.end() == optIt && pending_ && resume(nullptr, &key, 0))
+			  optIt = params_.find(key);
+		  return params_.end() != optIt ? &optIt->second : find_fallback(key);
+	  }
+
+      // the environment, then config files
+      StringType const* find_fallback(Tstring_view key) const
+	  {
+		  if (auto env = find_env(key))
+			  return env;
+		  auto entry = find_config(key);
+		  return entry && !entry->flag ? &entry->value : nullptr;
+	  }
+
+      struct config_entry;
+      config_entry const* find_config(Tstring_view key) const
+	  {
+		  auto it = std::lower_bound(config_.begin(), config_.end(), key, [](config_entry const& entry, Tstring_view k) { return Tstring_view(entry.key) < k; });
+		  return it != config_.end() && it->key == key ? &*it : nullptr;
+	  }
+
+      bool config_flag(Tstring_view key) const
+	  {
+		  auto entry = find_config(key);
+		  return entry && entry->flag;
+	  }
+
+      // a value read by load_config(): kept in config_store_ unless StringType owns it
+      StringType config_value(std::string_view value)
+	  {
+		  if constexpr (std::is_same_v<CharType, char>)
+			  return StringType(value);
+		  else if constexpr (std::is_same_v<StringType, Tstring_view>)
+		  {
+			  auto& decoded = config_store_->strings.emplace_back();
+			  detail::append_transcoded<CharType>(decoded, value);
+			  return decoded;
+		  }
+		  else
+		  {
+			  Tstring decoded;
+			  detail::append_transcoded<CharType>(decoded, value);
+			  return StringType(Tstring_view(decoded));
+		  }
+	  }
+
+      StringType const* find_env(Tstring_view key) const
+	  {
+		  auto it = std::lower_bound(env_.begin(), env_.end(), key, [](auto const& var, Tstring_view k) { return Tstring_view(var.first) < k; });
+		  return it != env_.end() && it->first == key ? &it->second : nullptr;
+	  }
+
+      // fills env_ from the bound variables
+      void read_env()
+	  {
+		  env_.clear();
+		  if (env_bindings_.empty() && !env_prefix_)
+			  return;
+
+		  std::vector<std::pair<Tstring, std::string>> bindings(env_bindings_.begin(), env_bindings_.end());
+		  auto const* index = names();
+		  if (env_prefix_ && index)
+		  {
+			  for (uint32_t i = 0; i < index->size(); ++i)
+			  {
+				  auto name = index->name(i);
+				  if (!index->is_param(i))
+					  continue;
+				  std::string variable = *env_prefix_;
+				  for (auto c : name)
+					  variable += 'a' <= c && c <= 'z' ? static_cast<char>(c - 'a' + 'A') : 0 < c && c < 0x80 && '-' != c ? static_cast<char>(c) : '_';
+				  bindings.emplace_back(Tstring(name), std::move(variable));
+			  }
+		  }
+		  // explicit bindings come first and win
+		  std::stable_sort(bindings.begin(), bindings.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+		  bindings.erase(std::unique(bindings.begin(), bindings.end(), [](auto const& a, auto const& b) { return a.first == b.first; }), bindings.end());
+
+		  detail::response_storage<CharType> transient;
+		  for (auto& binding : bindings)
+		  {
+			  auto const value = detail::read_env<CharType>(binding.second);
+			  if (!value)
+				  continue;
+			  if constexpr (std::is_same_v<StringType, Tstring_view>)
+				  env_.emplace_back(std::move(binding.first), arg_storage(transient).strings.emplace_back(*value));
+			  else
+				  env_.emplace_back(std::move(binding.first), StringType(Tstring_view(*value)));
+		  }
+	  }
+
+
+      bool has_positional(size_t ind) const
+	  {
+		  return ind < pos_args_.size() || (pending_ && resume(nullptr, nullptr, ind + 1));
+	  }
+
+      // LAZY_PARSE: steps from cursor_ on until the flag *flag or the param *param is reported, or
+      // positionals args are there (whichever is given, all of them null/0 to parse everything).
+      // Returns true if that happened. Seals the containers once the args run out.
+      bool resume(Tstring_view const* flag, Tstring_view const* param, size_t positionals) const;
+
+      StringType const* find_param(option_handle handle) const
+	  {
+		  finish();
+		  if (handle.id < handle_state_.size() && (handle_state_[handle.id] & seen_param))
+			  return &handle_values_[handle.id];
+		  return nullptr;
+	  }
+
+      // copies what the parse results hold for the interned name 'id' into its slot
+      void resolve(size_t id) const
+	  {
+		  Tstring_view name = interned_[id];
+		  auto param = params_.find(name);
+		  handle_state_[id] = (flags_.end() != flags_.find(name) || config_flag(name) ? seen_flag : 0) | (params_.end() != param ? seen_param : 0);
+		  if (params_.end() != param)
+			  handle_values_[id] = param->second;
+		  else if (auto fallback = find_fallback(name))
+		  {
+			  handle_state_[id] |= seen_param;
+			  handle_values_[id] = *fallback;
+		  }
+		  else
+			  handle_values_[id] = empty_;
+	  }
+
+      void resolve_handles() const
+	  {
+		  for (size_t id = 0; id < interned_.size(); ++id)
+			  resolve(id);
+	  }
+
+      option_spec<CharType> const* schema_spec(Tstring_view name) const
+	  {
+		  return schema_ ? schema_find_(schema_, name) : nullptr;
+	  }
+
+      // schema aliases map to the option name, anything else is kept as is
+      Tstring_view canonical(Tstring_view name) const
+	  {
+		  auto spec = schema_spec(name);
+		  return spec ? spec->name : name;
+	  }
+
+      bool is_param(Tstring_view name) const
+	  {
+		  if (auto const* index = names())
+		  {
+			  auto found = index->find(name);
+			  if (option_match<CharType>::exact == found.result && index->is_param(found.first))
+				  return true;
+		  }
+		  auto spec = schema_spec(name); // aliases
+		  return spec && option_kind::param == spec->kind;
+	  }
+
+      // ALLOW_ABBREVIATIONS: a --long option name that is the unique prefix of a known name becomes that name
+      Tstring_view expand(Tstring_view name, detail::token_info const& tok, int mode) const
+	  {
+		  if (!(mode & ALLOW_ABBREVIATIONS) || tok.dashes < 2)
+			  return name;
+		  auto const* index = names();
+		  if (!index)
+			  return name;
+		  auto found = index->find(name);
+		  return option_match<CharType>::prefix == found.result ? index->name(found.first) : name;
+	  }
+
+      // the option index, rebuilt first if a registration outdated it
+      detail::prefix_trie<CharType> const* names() const
+	  {
+		  if (names_dirty_.dirty.load(std::memory_order_acquire))
+		  {
+			  std::lock_guard<std::mutex> lock(names_dirty_.mutex);
+			  if (names_dirty_.dirty.load(std::memory_order_relaxed))
+			  {
+				  index_names();
+				  names_dirty_.dirty.store(false, std::memory_order_release);
+			  }
+		  }
+		  return names_.get();
+	  }
+
+      // rebuilds names_ from the registered params and the schema. Results of a view_parser that
+      // point into the old index (expanded abbreviations) make their storage keep it.
+      void index_names() const
+	  {
+		  detail::seal(registeredParams_);
+		  std::vector<std::pair<Tstring_view, bool>> names;
+		  auto const specs = schema_ ? schema_specs_(schema_).size() : 0;
+		  names.reserve(registeredParams_.size() + specs);
+		  for (auto const& name : registeredParams_)
+			  names.emplace_back(name, true);
+		  // both are in name order already: merged, not sorted
+		  auto const registered = names.size();
+		  for (size_t i = 0; i < specs; ++i)
+		  {
+			  auto const& spec = schema_by_name_(schema_, i);
+			  names.emplace_back(spec.name, option_kind::param == spec.kind);
+		  }
+		  std::inplace_merge(names.begin(), names.begin() + registered, names.end());
+
+		  if constexpr (std::is_same_v<StringType, Tstring_view>)
+		  {
+			  if (names_ && points_into(*names_))
+			  {
+				  detail::response_storage<CharType> unused;
+				  arg_storage(unused).indexes.push_back(std::move(names_));
+			  }
+		  }
+		  names_ = std::make_shared<detail::prefix_trie<CharType> const>(std::move(names));
+	  }
+
+      bool points_into(detail::prefix_trie<CharType> const& index) const
+	  {
+		  for (auto const& flag : flags_)
+			  if (index.owns(flag))
+				  return true;
+		  for (auto const& param : params_)
+			  if (index.owns(param.first))
+				  return true;
+		  for (auto const& param : repeated_params_)
+			  if (index.owns(param.first))
+				  return true;
+		  return false;
+	  }
+
+      bool is_flag(Tstring_view name) const
+	  {
+		  auto spec = schema_spec(name);
+		  return spec && option_kind::flag == spec->kind;
+	  }
+
+      // runs step() over args[0, count), classified in tokens
+      template<typename Args, typename Sink, typename ModeT>
+      void step_all(Args const& args, size_t count, std::vector<detail::token_info> const& tokens, ModeT mode, Sink& sink) const
+	  {
+		  for (size_t i = 0; i < count; ++i)
+		  {
+			  bool const last = i + 1 == count;
+			  Tstring_view next = last ? Tstring_view() : Tstring_view(args[i + 1]);
+			  sink.at(i);
+			  if (step(args[i], tokens[i], last ? nullptr : &next, last ? nullptr : &tokens[i + 1], mode, sink))
+				  ++i; // skip next value, it is not a free parameter
+		  }
+	  }
+
+      // step() fed one arg at a time, as they come: an arg is decided when the next one is pushed (or
+      // at end()), so only these two are kept. at() gives sink the index of the arg, counted from first.
+      template<typename Sink>
+      class stepper
+      {
+      public:
+         stepper(parser const& p, int mode, Sink& sink, size_t first = 0)
+            : p_(p), sink_(sink), mode_(mode), split_on_equal_(!(mode & NO_SPLIT_ON_EQUALSIGN)), index_(first)
+         {
+            assert(valid_mode(mode));
+         }
+
+         // a transient arg is only valid during the call, it is copied if it has to wait
+         void push(Tstring_view arg, bool transient = false)
+         {
+            auto const tok = detail::classify<CharType>(arg, split_on_equal_);
+            ++index_;
+            if (pending_)
+            {
+               sink_.at(index_ - 2);
+               if (p_.step(arg_, tok_, &arg, &tok, mode_, sink_))
+               {
+                  pending_ = false; // arg was the value
+                  return;
+               }
+            }
+            if (transient)
+               arg = buffer_.assign(arg.data(), arg.size());
+            arg_ = arg;
+            tok_ = tok;
+            pending_ = true;
+         }
+
+         void end()
+         {
+            if (!pending_)
+               return;
+            sink_.at(index_ - 1);
+            p_.step(arg_, tok_, nullptr, nullptr, mode_, sink_);
+            pending_ = false;
+         }
+
+      private:
+         parser const& p_;
+         Sink& sink_;
+         int mode_;
+         bool split_on_equal_;
+         bool pending_ = false;
+         size_t index_;
+         Tstring_view arg_;
+         detail::token_info tok_;
+         std::basic_string<CharType> buffer_;
+      };
+
+      // pushes arg, or the args of the response file it names, into steps
+      template<typename Sink>
+      void push_expanded(stepper<Sink>& steps, Tstring_view arg, bool transient, int depth) const
+	  {
+		  std::unique_ptr<detail::mapped_file> file;
+		  if (1 < arg.size() && '@' == arg[0] && depth < max_response_depth)
+			  file = detail::open_response_file(arg.substr(1));
+		  if (!file || !file->is_open())
+			  return steps.push(arg, transient);
+
+		  std::string scratch;
+		  std::basic_string<CharType> decoded;
+		  detail::tokenize_response(file->contents(), scratch, [&](std::string_view token, bool)
+		  {
+			  if constexpr (std::is_same_v<CharType, char>)
+				  push_expanded(steps, token, true, depth + 1);
+			  else
+			  {
+				  decoded.clear();
+				  detail::append_transcoded<CharType>(decoded, token);
+				  push_expanded(steps, decoded, true, depth + 1);
+			  }
+		  });
+	  }
+
+      // lines taken at once by a parse_batch() thread
+      static constexpr size_t batch_chunk = 256;
+
+      // the parse state machine, see the definition below. ModeT is int or a fixed_mode.
+      template<typename Sink, typename ModeT>
+      bool step(Tstring_view arg, detail::token_info const& tok, Tstring_view const* next, detail::token_info const* next_tok, ModeT mode, Sink& sink) const;
+
+      // appends arg to args_, or the args of the response file it names (see EXPAND_RESPONSE_FILES)
+      void append_arg(Tstring_view arg, detail::response_storage<CharType>& store, int depth);
+
+      // nested @files deeper than this are left as they are, which also ends cycles
+      static constexpr int max_response_depth = 16;
+
+      // shared by the parse() overloads, see the definition below
+      template<typename ModeT, typename Fill>
+      void parse_with(ModeT mode, bool move_results, Fill&& fill);
+
+      // parse(argc, argv) for a given mode, int or fixed_mode
+      template<typename ModeT>
+      void parse_argv(size_t argc, const CharType* const argv[], ModeT mode);
+
+      // where args that nothing else keeps alive go: the parser (and its copies) keeps them for views,
+      // copies need them only during parse()
+      detail::response_storage<CharType>& arg_storage(detail::response_storage<CharType>& transient) const
+      {
+         if constexpr (!std::is_same_v<StringType, Tstring_view>)
+            return transient;
+         else
+         {
+            if (!responses_)
+               responses_ = std::make_shared<detail::response_storage<CharType>>();
+            return *responses_;
+         }
+      }
+
+      // the end of feed(): the held arg has no lookahead
+      void end_feed() const
+	  {
+		  if (feed_held_)
+		  {
+			  store_sink sink{ *this };
+			  step(Tstring_view(feed_arg_), feed_tok_, nullptr, nullptr, feed_mode_, sink);
+		  }
+		  feeding_ = feed_held_ = false;
+		  detail::seal_params(params_, repeated_params_);
+		  detail::seal(flags_);
+		  resolve_handles();
+		  cache_.clear(); // what was cached while feeding predates the rest of the args
+	  }
+
+      // stores what step() reports into the parser's containers
+      struct store_sink
+      {
+         parser const& p; // the results are mutable
+         void at(size_t)                                 {}
+         void positional(Tstring_view arg)               { p.pos_args_.emplace_back(arg); }
+         void flag(Tstring_view name)                    { p.flags_.emplace(name); }
+         void param(Tstring_view name, Tstring_view val) { detail::emplace_param(p.params_, p.repeated_params_, name, val); }
+      };
+
+      // store_sink for args_ that are not needed after parse(): values that are a whole arg are moved
+      struct move_sink
+      {
+         parser& p;
+         size_t i = 0; // the arg step() is at
+
+         void at(size_t ind)                             { i = ind; }
+         void positional(Tstring_view arg)               { if (auto whole = whole_arg(arg, i)) p.pos_args_.emplace_back(std::move(*whole)); else p.pos_args_.emplace_back(arg); }
+         void flag(Tstring_view name)                    { p.flags_.emplace(name); }
+         void param(Tstring_view name, Tstring_view val)
+         {
+            if (auto whole = whole_arg(val, i + 1))
+               detail::emplace_param(p.params_, p.repeated_params_, name, std::move(*whole));
+            else
+               detail::emplace_param(p.params_, p.repeated_params_, name, val);
+         }
+
+         // args_[ind] if str is all of it
+         StringType* whole_arg(Tstring_view str, size_t ind) const
+         {
+            if (ind < p.args_.size() && str.data() == Tstring_view(p.args_[ind]).data() && str.size() == p.args_[ind].size())
+               return &p.args_[ind];
+            return nullptr;
+         }
+      };
+
+#if defined(ARGH_ENABLE_STATS)
+      // stored strings that do not fit in the small string buffer, each of them allocated once: in the
+      // results, and in args_ too if with_args. By size, as args_ keeps the capacity of earlier parses.
+      size_t count_string_allocations(bool with_args) const
+      {
+         if constexpr (std::is_same_v<StringType, Tstring_view>)
+            return 0;
+         else
+         {
+            auto const small = StringType().capacity();
+            size_t count = 0;
+            auto add = [&](StringType const& str) { count += small < str.size(); };
+            if (with_args)
+               std::for_each(args_.begin(), args_.end(), add);
+            std::for_each(pos_args_.begin(), pos_args_.end(), add);
+            std::for_each(flags_.begin(), flags_.end(), add);
+            for (auto const& param : params_)
+            {
+               add(param.first);
+               add(param.second);
+            }
+            for (auto const& param : repeated_params_)
+            {
+               add(param.first);
+               add(param.second);
+            }
+            return count;
+         }
+      }
+#endif
+
+   private:
+      // the results are mutable: a LAZY_PARSE parser fills them from const accessors
+      ARGH_STATS(parse_stats stats_;)
+      mutable std::vector<detail::token_info> tokens_; // classification of args_, capacity is reused
+      args_type args_;
+      mutable params_type params_;
+      mutable repeated_params_type repeated_params_; // the values after the first one of repeated params, in order
+      mutable args_type pos_args_;
+      mutable flags_type flags_;
+      mutable registry_type registeredParams_; // always owned, registered names may be temporaries
+      mutable std::shared_ptr<detail::response_storage<CharType>> responses_; // what view args from @files (or moved in strings) point into
+      mutable std::shared_ptr<detail::prefix_trie<CharType> const> names_; // registered and schema names, see names()
+      mutable detail::rebuild_flag names_dirty_;
+      slice<option_spec<CharType>> (*schema_specs_)(void const*) = nullptr;
+      option_spec<CharType> const& (*schema_by_name_)(void const*, size_t) = nullptr;
+      void const* schema_ = nullptr;
+      option_spec<CharType> const* (*schema_find_)(void const*, Tstring_view) = nullptr;
+      StringType empty_;
+
+      // environment fallback: the bindings and the values parse() read, sorted by param name
+      std::vector<std::pair<Tstring, std::string>> env_bindings_;
+      std::optional<std::string> env_prefix_;
+      std::vector<std::pair<Tstring, StringType>> env_;
+
+      // load_config() entries, one per key sorted by key, what their values point into and the paths
+      struct config_entry
+      {
+         Tstring key;
+         StringType value;
+         bool flag;
+         uint32_t file; // in config_paths_
+         uint32_t line;
+      };
+      std::vector<config_entry> config_;
+      std::shared_ptr<detail::response_storage<CharType>> config_store_;
+      std::deque<std::string> config_paths_;
+
+      // interned names by handle id, and what the last parse found for them. The values are copies
+      // (views with a view_parser), so copies of the parser keep valid slots.
+      static constexpr uint8_t seen_flag = 1, seen_param = 2;
+      std::vector<name_type, detail::rebind_alloc<detail::container_allocator<allocator_type>, name_type>> interned_;
+      detail::id_table<CharType, detail::rebind_alloc<detail::container_allocator<allocator_type>, uint32_t>> interned_index_;
+      mutable args_type handle_values_;
+      mutable std::vector<uint8_t, detail::rebind_alloc<detail::container_allocator<allocator_type>, uint8_t>> handle_state_;
+      mutable detail::typed_cache<CharType> cache_; // see cached()
+
+      // LAZY_PARSE state: what is left to parse
+      mutable bool pending_ = false;  // args_ not fully parsed yet
+      mutable size_t cursor_ = 0;     // next arg for the state machine
+      mutable size_t classified_ = 0; // args with a tokens_ entry
+      int lazy_mode_ = 0;
+
+      // feed() state: the held arg (a copy, or a view into responses_) waiting for its lookahead
+      mutable bool feeding_ = false;
+      mutable bool feed_held_ = false;
+      mutable StringType feed_arg_;
+      detail::token_info feed_tok_;
+      int feed_mode_ = 0;
+   };
+
+   // zero-copy parser: flags, params and positional args are views into argv (or into any buffer
+   // the caller passes to parse()), which must stay alive as long as the results are used.
+   template<typename CharType = char, typename Storage = tree_storage>
+   using view_parser = parser<CharType, std::basic_string_view<CharType>, Storage>;
+
+#if defined(ARGH_HAS_PMR)
+   namespace pmr
+   {
+      // parser whose strings and containers all allocate from a std::pmr::memory_resource, e.g.
+      //    std::pmr::monotonic_buffer_resource arena;
+      //    argh::pmr::parser<> cmdl(&arena);
+      // releases everything in one go when the arena goes away.
+      template<typename CharType = char, typename Storage = tree_storage>
+      using parser = argh::parser<CharType, std::pmr::basic_string<CharType>, Storage>;
+   }
+#endif
+
+   //////////////////////////////////////////////////////////////////////////
+   // Subcommands, as in "tool --verbose build --jobs 4 target": a tree of commands, each with its own
+   // parser. parse() gives a command's parser the args up to the first positional arg that names one
+   // of its subcommands (the name is positional arg 0, as argv[0] is for the root) and continues in the
+   // subcommand with the rest. A command's parser is built, and its setup (add_params(), use_schema())
+   // run, the first time the command is used, so only the commands on the command line cost anything.
+   //
+   //    argh::command_tree<> tool([](auto& p) { p.add_params({ "config" }); });
+   //    tool.add("build", [](auto& p) { p.add_params({ "jobs" }); });
+   //    auto& cmd = tool.parse(argc, argv);
+   //    if ("build" == cmd.name())
+   //       jobs = cmd.args().get("jobs", 1);
+   //
+   // Subcommand names must be on the command line itself, not in response files.
+   template<typename CharType = char, typename StringType = std::basic_string<CharType>, typename Storage = tree_storage>
+   class command_tree
+   {
+      using Tstring_view = std::basic_string_view<CharType>;
+
+   public:
+      using parser_type = parser<CharType, StringType, Storage>;
+      using setup_type = std::function<void(parser_type&)>;
+
+      explicit command_tree(setup_type setup = {}) : setup_(std::move(setup)) {}
+
+      // adds a subcommand and returns it, to add subcommands of its own
+      command_tree& add(Tstring_view name, setup_type setup = {})
+      {
+         auto command = std::make_unique<command_tree>(std::move(setup));
+         command->name_ = name;
+         command->parent_ = this;
+         children_.push_back(std::move(command));
+         return *children_.back();
+      }
+
+      // returns the subcommand called name, or nullptr
+      command_tree const* find(Tstring_view name) const { return child(name); }
+
+      // parses argv into the parsers of this command and the subcommands it names, and returns the
+      // last command used (this one if there is no subcommand). Replaces the results of the last parse().
+      command_tree const& parse(size_t argc, const CharType* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION)
+      {
+         for (auto command = this; command; command = std::exchange(command->active_, nullptr))
+         {
+            if (command->parser_)
+               command->parser_->reset();
+         }
+
+         auto command = this;
+         for (size_t first = 0;;)
+         {
+            auto& p = command->built();
+            auto const sub = command->find_subcommand(p, argv, first, argc, mode);
+            p.parse(sub - first, argv + first, mode);
+            if (sub == argc)
+               return *command;
+            command = command->active_ = command->child(Tstring_view(argv[sub], detail::length(argv[sub])));
+            first = sub;
+         }
+      }
+
+      // argv ends with a nullptr
+      command_tree const& parse(const CharType* const argv[], int mode = PREFER_FLAG_FOR_UNREG_OPTION)
+      {
+         size_t argc = 0;
+         while (argv[argc])
+            ++argc;
+         return parse(argc, argv, mode);
+      }
+
+      Tstring_view name()           const { return name_;   }
+      command_tree const* parent()  const { return parent_; }
+      command_tree const* active()  const { return active_; } // the subcommand of the last parse(), or nullptr
+
+      // the parser of this command, built on first use
+      parser_type const& args() const { return built(); }
+
+   private:
+      parser_type& built() const
+      {
+         if (!parser_)
+         {
+            parser_ = std::make_unique<parser_type>();
+            if (setup_)
+               setup_(*parser_);
+         }
+         return *parser_;
+      }
+
+      command_tree* child(Tstring_view name) const
+      {
+         auto it = std::find_if(children_.begin(), children_.end(), [&](auto const& c) { return c->name_ == name; });
+         return it != children_.end() ? it->get() : nullptr;
+      }
+
+      // the index of the first positional arg in argv[first + 1, last) that names a subcommand, or last
+      size_t find_subcommand(parser_type const& p, const CharType* const argv[], size_t first, size_t last, int mode) const
+      {
+         if (children_.empty())
+            return last;
+
+         struct sink
+         {
+            command_tree const& tree;
+            size_t none;
+            size_t found;
+            size_t i = 0;
+            void at(size_t ind)                             { i = ind; }
+            void positional(Tstring_view arg)               { if (none == found && tree.find(arg)) found = i; }
+            void flag(Tstring_view)                         {}
+            void param(Tstring_view, Tstring_view)          {}
+         } s{ *this, last, last };
+
+         typename parser_type::template stepper<sink> steps(p, mode, s, first + 1);
+         for (size_t i = first + 1; i < last && last == s.found; ++i)
+            steps.push(Tstring_view(argv[i], detail::length(argv[i])));
+         steps.end();
+         return s.found;
+      }
+
+      std::basic_string<CharType> name_;
+      setup_type setup_;
+      command_tree* parent_ = nullptr;
+      command_tree* active_ = nullptr;
+      std::vector<std::unique_ptr<command_tree>> children_;
+      mutable std::unique_ptr<parser_type> parser_;
+   };
+
+
+   //////////////////////////////////////////////////////////////////////////
+
+   // the usual modes get a loop of their own, others are tested at run time
+   template<typename CharType, typename StringType, typename Storage>
+   inline void parser<CharType, StringType, Storage>::parse(size_t argc, const CharType* const argv[], int mode /*= PREFER_FLAG_FOR_UNREG_OPTION*/)
+   {
+      switch (mode)
+      {
+      case 0:
+      case PREFER_FLAG_FOR_UNREG_OPTION:
+         return parse_argv(argc, argv, fixed_mode<PREFER_FLAG_FOR_UNREG_OPTION>());
+      case PREFER_PARAM_FOR_UNREG_OPTION:
+         return parse_argv(argc, argv, fixed_mode<PREFER_PARAM_FOR_UNREG_OPTION>());
+      case PREFER_FLAG_FOR_UNREG_OPTION | NO_SPLIT_ON_EQUALSIGN:
+         return parse_argv(argc, argv, fixed_mode<PREFER_FLAG_FOR_UNREG_OPTION | NO_SPLIT_ON_EQUALSIGN>());
+      case PREFER_PARAM_FOR_UNREG_OPTION | NO_SPLIT_ON_EQUALSIGN:
+         return parse_argv(argc, argv, fixed_mode<PREFER_PARAM_FOR_UNREG_OPTION | NO_SPLIT_ON_EQUALSIGN>());
+      case PREFER_FLAG_FOR_UNREG_OPTION | SINGLE_DASH_IS_MULTIFLAG:
+         return parse_argv(argc, argv, fixed_mode<PREFER_FLAG_FOR_UNREG_OPTION | SINGLE_DASH_IS_MULTIFLAG>());
+      case PREFER_PARAM_FOR_UNREG_OPTION | SINGLE_DASH_IS_MULTIFLAG:
+         return parse_argv(argc, argv, fixed_mode<PREFER_PARAM_FOR_UNREG_OPTION | SINGLE_DASH_IS_MULTIFLAG>());
+      default:
+         return parse_argv(argc, argv, mode);
+      }
+   }
+
+   template<typename CharType, typename StringType, typename Storage>
+   template<typename ModeT>
+   inline void parser<CharType, StringType, Storage>::parse_argv(size_t argc, const CharType* const argv[], ModeT mode)
+   {
+      parse_with(mode, false, [&]
+      {
+         // convert to strings (views in zero-copy mode)
+         if (mode & EXPAND_RESPONSE_FILES)
+         {
+            detail::response_storage<CharType> transient;
+            auto& store = arg_storage(transient);
+            args_.clear();
+            for (size_t i = 0; i < argc; ++i)
+               append_arg(Tstring_view(argv[i], detail::length(argv[i])), store, 0);
+         }
+         else
+         {
+            args_.resize(argc);
+            std::transform(argv, argv + argc, args_.begin(), [](const CharType* const arg) { return Tstring_view(arg, detail::length(arg)); });
+         }
+      });
+   }
+
+   template<typename CharType, typename StringType, typename Storage>
+   template<typename Range, typename>
+   inline void parser<CharType, StringType, Storage>::parse(Range&& args, int mode /*= PREFER_FLAG_FOR_UNREG_OPTION*/)
+   {
+      using element = std::remove_reference_t<decltype(*std::begin(args))>;
+      constexpr bool views = std::is_same_v<StringType, Tstring_view>;
+      constexpr bool rvalue = !std::is_lvalue_reference_v<Range> && !std::is_const_v<element>;
+      constexpr bool owned = !std::is_same_v<std::remove_cv_t<element>, Tstring_view>;
+      constexpr bool movable = rvalue && std::is_same_v<std::remove_cv_t<element>, std::conditional_t<views, Tstring, StringType>>;
+
+      parse_with(mode, !views, [&]
+      {
+         detail::response_storage<CharType> transient;
+         auto& store = arg_storage(transient);
+         args_.clear();
+         for (auto&& arg : args)
+         {
+            Tstring_view view = arg;
+            if constexpr (views && rvalue && owned) // nothing else keeps these alive
+            {
+               if constexpr (movable)
+                  view = store.strings.emplace_back(std::move(arg));
+               else
+                  view = store.strings.emplace_back(view);
+            }
+
+            if (mode & EXPAND_RESPONSE_FILES)
+               append_arg(view, store, 0);
+            else if constexpr (movable && !views)
+               args_.emplace_back(std::move(arg));
+            else
+               args_.emplace_back(view);
+         }
+      });
+   }
+
+   // fill() sets args_, the rest is common to the parse() overloads. With move_results, positional args
+   // and separate param values are moved out of args_ instead of copied.
+   template<typename CharType, typename StringType, typename Storage>
+   template<typename ModeT, typename Fill>
+   inline void parser<CharType, StringType, Storage>::parse_with(ModeT mode, bool move_results, Fill&& fill)
+   {
+      assert(valid_mode(mode));
+
+      ARGH_STATS(
+         using clock = std::chrono::steady_clock;
+         stats_ = parse_stats();
+         auto const allocations_before = detail::allocation_count();
+         auto const classify_start = clock::now();
+      )
+
+      detail::seal(registeredParams_);
+      finish(); // a lazy parse before this one needs its args
+      cache_.clear();
+      read_env();
+
+      ARGH_STATS(auto const strings_before = count_string_allocations(false);) // the results add up
+      fill();
+      ARGH_STATS(stats_.tokens = args_.size();)
+
+      tokens_.resize(args_.size());
+      if (mode & LAZY_PARSE)
+      {
+         pending_ = true;
+         cursor_ = classified_ = 0;
+         lazy_mode_ = mode;
+         return;
+      }
+
+      // classification pass: every token is scanned once, the state machine only reads tokens_
+      bool const split_on_equal = !(mode & NO_SPLIT_ON_EQUALSIGN);
+      for (size_t i = 0; i < args_.size(); ++i)
+      {
+         tokens_[i] = detail::classify<CharType>(args_[i], split_on_equal);
+         ARGH_STATS(stats_.number_probes += !args_[i].empty() && '-' == args_[i][0];)
+      }
+
+      ARGH_STATS(auto const insert_start = clock::now();)
+
+      // parse line
+      if (move_results)
+      {
+         move_sink sink{ *this };
+         step_all(args_, args_.size(), tokens_, mode, sink);
+      }
+      else
+      {
+         store_sink sink{ *this };
+         step_all(args_, args_.size(), tokens_, mode, sink);
+      }
+
+      detail::seal_params(params_, repeated_params_);
+      detail::seal(flags_);
+      resolve_handles();
+
+      ARGH_STATS(
+         auto const insert_end = clock::now();
+         stats_.classify_time = std::chrono::duration_cast<std::chrono::nanoseconds>(insert_start - classify_start);
+         stats_.insert_time = std::chrono::duration_cast<std::chrono::nanoseconds>(insert_end - insert_start);
+         stats_.container_allocations = detail::allocation_count() - allocations_before;
+         stats_.string_allocations = count_string_allocations(true) - strings_before;
+      )
+   }
+
+   template<typename CharType, typename StringType, typename Storage>
+   inline bool parser<CharType, StringType, Storage>::resume(Tstring_view const* flag, Tstring_view const* param, size_t positionals) const
+   {
+      // stores and reports whether the watched flag or param went by
+      struct watch_sink : store_sink
+      {
+         Tstring_view const* watched_flag;
+         Tstring_view const* watched_param;
+         bool found = false;
+
+         void flag(Tstring_view name)
+         {
+            store_sink::flag(name);
+            found = found || (watched_flag && *watched_flag == name);
+         }
+
+         void param(Tstring_view name, Tstring_view val)
+         {
+            store_sink::param(name, val);
+            found = found || (watched_param && *watched_param == name);
+         }
+      };
+
+      // room for every positional that may come, so operator[](size_t) references stay valid
+      auto const most = pos_args_.size() + (args_.size() - cursor_);
+      if (pos_args_.capacity() < most)
+         pos_args_.reserve(most);
+
+      watch_sink sink{ { *this }, flag, param };
+      bool const split_on_equal = !(lazy_mode_ & NO_SPLIT_ON_EQUALSIGN);
+      while (cursor_ < args_.size())
+      {
+         auto const i = cursor_;
+         bool const last = i + 1 == args_.size();
+         for (; classified_ < std::min(i + 2, args_.size()); ++classified_)
+            tokens_[classified_] = detail::classify<CharType>(args_[classified_], split_on_equal);
+
+         Tstring_view next = last ? Tstring_view() : Tstring_view(args_[i + 1]);
+         cursor_ += step(args_[i], tokens_[i], last ? nullptr : &next, last ? nullptr : &tokens_[i + 1], lazy_mode_, sink) ? 2 : 1;
+         if (sink.found || (positionals && positionals <= pos_args_.size()))
+            return true;
+      }
+
+      pending_ = false;
+      detail::seal_params(params_, repeated_params_);
+      detail::seal(flags_);
+      resolve_handles();
+      return false;
+   }
+
+   // Response file args are tokenized straight into args_. Verbatim args of a char file are views of the
+   // file, the others are unquoted or decoded from UTF-8 into store. A file that cannot be opened leaves
+   // its "@file" arg in place, as gcc does.
+   template<typename CharType, typename StringType, typename Storage>
+   inline void parser<CharType, StringType, Storage>::append_arg(Tstring_view arg, detail::response_storage<CharType>& store, int depth)
+   {
+      std::unique_ptr<detail::mapped_file> file;
+      if (1 < arg.size() && '@' == arg[0] && depth < max_response_depth)
+         file = detail::open_response_file(arg.substr(1));
+      if (!file || !file->is_open())
+      {
+         args_.emplace_back(arg);
+         return;
+      }
+
+      std::string scratch; // per level: an unquoted arg may itself name a file
+      detail::tokenize_response(file->contents(), scratch, [&](std::string_view token, bool unquoted)
+      {
+         if constexpr (std::is_same_v<CharType, char>)
+         {
+            if (unquoted && std::is_same_v<StringType, Tstring_view>)
+               token = store.strings.emplace_back(token);
+            append_arg(token, store, depth + 1);
+         }
+         else
+         {
+            auto& decoded = store.strings.emplace_back();
+            detail::append_transcoded<CharType>(decoded, token);
+            append_arg(decoded, store, depth + 1);
+         }
+      });
+      store.files.push_back(std::move(file));
+   }
+
+   template<typename CharType, typename StringType, typename Storage>
+   inline batch_result<CharType> parser<CharType, StringType, Storage>::parse_batch(command_line<CharType> const* lines, size_t count,
+      int mode /*= PREFER_FLAG_FOR_UNREG_OPTION*/, unsigned threads /*= 0*/) const
+   {
+      assert(valid_mode(mode));
+      bool const split_on_equal = !(mode & NO_SPLIT_ON_EQUALSIGN);
+      size_t const chunks = (count + batch_chunk - 1) / batch_chunk;
+      std::vector<batch_result<CharType>> results(chunks);
+      std::atomic<size_t> next_chunk{ 0 };
+      std::exception_ptr error;
+      std::atomic<bool> failed{ false };
+
+      auto work = [&]
+      {
+         std::vector<detail::token_info> tokens;
+         std::vector<Tstring_view> args;
+         try
+         {
+            for (size_t chunk; !failed && (chunk = next_chunk++) < chunks;)
+            {
+               auto& result = results[chunk];
+               typename batch_result<CharType>::sink sink{ result };
+               for (size_t l = chunk * batch_chunk; l < std::min(count, (chunk + 1) * batch_chunk); ++l)
+               {
+                  auto const& line = lines[l];
+                  tokens.resize(line.argc);
+                  args.resize(line.argc);
+                  for (size_t i = 0; i < line.argc; ++i)
+                  {
+                     args[i] = Tstring_view(line.argv[i], detail::length(line.argv[i]));
+                     tokens[i] = detail::classify<CharType>(args[i], split_on_equal);
+                  }
+                  step_all(args, line.argc, tokens, mode, sink);
+                  result.end_line();
+               }
+            }
+         }
+         catch (...)
+         {
+            if (!failed.exchange(true))
+               error = std::current_exception();
+         }
+      };
+
+      if (0 == threads)
+         threads = std::max(1u, std::thread::hardware_concurrency());
+      threads = static_cast<unsigned>(std::min<size_t>(threads, chunks));
+      std::vector<std::thread> pool;
+      try
+      {
+         for (unsigned t = 1; t < threads; ++t) // the calling thread is one of them
+            pool.emplace_back(work);
+      }
+      catch (std::system_error const&) {} // out of threads: fewer of them share the chunks
+      work();
+      for (auto& thread : pool)
+         thread.join();
+      if (error)
+         std::rethrow_exception(error);
+
+      // concatenate the chunks, in order
+      batch_result<CharType> all;
+      size_t flags = 0, params = 0, pos_args = 0;
+      for (auto const& result : results)
+      {
+         flags += result.flags_.size();
+         params += result.params_.size();
+         pos_args += result.pos_args_.size();
+      }
+      all.flags_.reserve(flags);
+      all.params_.reserve(params);
+      all.pos_args_.reserve(pos_args);
+      all.flag_offsets_.reserve(count + 1);
+      all.param_offsets_.reserve(count + 1);
+      all.pos_offsets_.reserve(count + 1);
+      for (auto const& result : results)
+         all.append(result);
+      all.schema_ = schema_;
+      all.schema_find_ = schema_find_;
+      names();
+      all.names_ = names_;
+      return all;
+   }
+
+   template<typename CharType, typename StringType, typename Storage>
+   inline std::shared_ptr<snapshot<CharType> const> parser<CharType, StringType, Storage>::freeze(uint64_t key) const
+   {
+      finish();
+
+      std::vector<std::pair<Tstring_view, Tstring_view>> params(params_.begin(), params_.end());
+      params.insert(params.end(), repeated_params_.begin(), repeated_params_.end());
+      // the environment and config values get() falls back to, for the params argv lacks, and the
+      // config flags
+      for (auto const& var : env_)
+      {
+         if (params_.end() == params_.find(Tstring_view(var.first)))
+            params.emplace_back(var.first, var.second);
+      }
+      std::vector<Tstring_view> flags(flags_.begin(), flags_.end());
+      for (auto const& entry : config_)
+      {
+         if (entry.flag)
+         {
+            if (flags_.end() == flags_.find(Tstring_view(entry.key)))
+               flags.push_back(entry.key);
+         }
+         else if (params_.end() == params_.find(Tstring_view(entry.key)) && !find_env(entry.key))
+            params.emplace_back(entry.key, entry.value);
+      }
+      std::sort(flags.begin(), flags.end());
+      std::stable_sort(params.begin(), params.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+
+      std::vector<std::pair<Tstring_view, Tstring_view>> aliases;
+      if (schema_)
+      {
+         for (auto const& spec : schema_specs_(schema_))
+         {
+            if (!spec.alias.empty())
+               aliases.emplace_back(spec.alias, spec.name);
+         }
+         std::sort(aliases.begin(), aliases.end());
+      }
+
+      size_t pool_size = 0;
+      for (auto const& flag : flags)
+         pool_size += flag.size();
+      for (auto const& param : params)
+         pool_size += param.first.size() + param.second.size();
+      for (auto const& arg : pos_args_)
+         pool_size += arg.size();
+      for (auto const& alias : aliases)
+         pool_size += alias.first.size() + alias.second.size();
+
+      using layout = typename snapshot<CharType>::layout;
+      layout const at(flags.size(), params.size(), pos_args_.size(), aliases.size(), pool_size);
+      std::shared_ptr<snapshot<CharType>> frozen(new snapshot<CharType>());
+      auto& blob = frozen->owned_;
+      blob.resize(at.size);
+
+      detail::blob_header header = { { 'a', 'r', 'g', 'h' }, detail::blob_version, sizeof(CharType), detail::endian_marker,
+                                     static_cast<uint32_t>(flags.size()), static_cast<uint32_t>(params.size()),
+                                     static_cast<uint32_t>(pos_args_.size()), static_cast<uint32_t>(aliases.size()),
+                                     key, pool_size, at.size };
+      std::memcpy(&blob[0], &header, sizeof(header));
+
+      // the parts are filled in order, each through its own cursor
+      size_t refs = at.flags, numbers = at.param_numbers, pool = 0;
+      auto keep = [&](Tstring_view str)
+      {
+         detail::blob_ref const r = { static_cast<uint32_t>(pool), static_cast<uint32_t>(str.size()) };
+         std::memcpy(&blob[at.pool + pool * sizeof(CharType)], str.data(), str.size() * sizeof(CharType));
+         std::memcpy(&blob[refs], &r, sizeof(r));
+         refs += sizeof(r);
+         pool += str.size();
+         return r;
+      };
+      auto add_number = [&](Tstring_view str)
+      {
+         auto const n = detail::to_blob_number(str);
+         std::memcpy(&blob[numbers], &n, sizeof(n));
+         numbers += sizeof(n);
+      };
+
+      for (auto const& flag : flags)
+         keep(flag);
+      detail::blob_ref name = {};
+      for (size_t i = 0; i < params.size(); ++i)
+      {
+         if (0 < i && params[i].first == params[i - 1].first) // a repeat references the name again
+         {
+            std::memcpy(&blob[refs], &name, sizeof(name));
+            refs += sizeof(name);
+         }
+         else
+            name = keep(params[i].first);
+      }
+      for (auto const& param : params)
+      {
+         keep(param.second);
+         add_number(param.second);
+      }
+      for (auto const& arg : pos_args_)
+      {
+         keep(arg);
+         add_number(arg);
+      }
+      for (auto const& alias : aliases)
+      {
+         keep(alias.first);
+         keep(alias.second);
+      }
+
+      frozen->open(blob.data(), blob.size());
+      return frozen;
+   }
+
+   // Decides what arg is, given its classification and the one of the next token (nullptr if arg is the
+   // last one) and reports it to sink as sink.positional(arg), sink.flag(name) or sink.param(name, value).
+   // Names and values are sub-views of arg and *next. Returns true if *next was consumed as a value.
+   template<typename CharType, typename StringType, typename Storage>
+   template<typename Sink, typename ModeT>
+   inline bool parser<CharType, StringType, Storage>::step(Tstring_view arg, detail::token_info const& tok,
+      Tstring_view const* next, detail::token_info const* next_tok, ModeT mode, Sink& sink) const
+   {
+      if (!tok.option)
+      {
+         sink.positional(arg);
+         return false;
+      }
+
+      auto name = arg.substr(tok.dashes);
+
+      // only recorded when splitting on '=' (no NO_SPLIT_ON_EQUALSIGN)
+      if (detail::token_info::npos != tok.equal)
+      {
+         sink.param(expand(canonical(name.substr(0, tok.equal)), tok, mode), name.substr(tok.equal + 1));
+         return false;
+      }
+
+      // if the option is unregistered and should be a multi-flag
+      if (1 == tok.dashes &&                         // single dash
+         Mode::SINGLE_DASH_IS_MULTIFLAG & mode &&    // multi-flag mode
+         !is_param(name) && !is_flag(name))          // unregistered
+      {
+         Tstring_view keep_param;
+
+         if (!name.empty() && is_param(name.substr(name.size() - 1))) // last char is param
+         {
+            keep_param = name.substr(name.size() - 1);
+            name.remove_suffix(1);
+         }
+
+         for (size_t c = 0; c < name.size(); ++c)
+         {
+            sink.flag(canonical(name.substr(c, 1)));
+         }
+
+         if (keep_param.empty())
+            return false; // do not consider other options for this arg
+
+         name = keep_param;
+      }
+
+      name = expand(canonical(name), tok, mode);
+
+      // any potential option will get as its value the next arg, unless that arg is an option too
+      // in that case it will be determined a flag. Options the schema declares as flags never take a value.
+      if (!next || next_tok->option || is_flag(name))
+      {
+         sink.flag(name);
+         return false;
+      }
+
+      // if 'name' is a pre-registered option, then the next arg cannot be a free parameter to it is skipped
+      // otherwise we have 2 modes:
+      // PREFER_FLAG_FOR_UNREG_OPTION: a non-registered 'name' is determined a flag.
+      //                               The following value (the next arg) will be a free parameter.
+      //
+      // PREFER_PARAM_FOR_UNREG_OPTION: a non-registered 'name' is determined a parameter, the next arg
+      //                                will be the value of that option.
+
+      // (valid_mode() is checked where mode comes in, not per arg)
+      bool const preferParam = mode & Mode::PREFER_PARAM_FOR_UNREG_OPTION;
+
+      if (preferParam || is_param(name))
+      {
+         sink.param(name, *next);
+         return true;
+      }
+
+      sink.flag(name);
+      return false;
    }
 }
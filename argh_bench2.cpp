@@ -0,0 +1,585 @@
+// Standalone benchmark suite for argh2.h, no dependencies:
+//    g++ -std=c++17 -O2 -pthread argh_bench2.cpp -o argh_bench2 && ./argh_bench2 [--quick]
+//
+// Reports time per token (or per lookup) and heap allocations per parse (or per lookup), counted by
+// replacing the global operator new.
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete" // the replaced operator delete below calls free()
+#endif
+
+#include "argh2.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+   size_t allocations = 0;
+}
+
+void* operator new(size_t size)
+{
+   ++allocations;
+   if (void* p = std::malloc(size ? size : 1))
+      return p;
+   throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace
+{
+   double min_seconds = 0.2;
+
+   // The parse loop as it was before the classification pass: an istringstream number probe per
+   // is_option() call, lookahead classified again on the next iteration, substr copies.
+   struct legacy_parser
+   {
+      std::vector<std::string> args_, pos_args_;
+      std::map<std::string, std::string> params_;
+      std::multiset<std::string> flags_;
+
+      static bool is_number(std::string const& arg)
+      {
+         std::istringstream istr(arg);
+         double number;
+         istr >> number;
+         return !(istr.fail() || istr.bad());
+      }
+
+      static bool is_option(std::string const& arg)
+      {
+         if (is_number(arg))
+            return false;
+         return '-' == arg[0] || '/' == arg[0];
+      }
+
+      static std::string trim_leading_dashes(std::string const& name)
+      {
+         auto pos = name.find_first_not_of('-');
+         if (!pos || (pos == std::string::npos))
+            pos = name.find_first_not_of('/');
+         return std::string::npos != pos ? name.substr(pos) : name;
+      }
+
+      void parse(size_t argc, const char* const argv[])
+      {
+         args_.assign(argv, argv + argc);
+         for (size_t i = 0; i < args_.size(); ++i)
+         {
+            if (!is_option(args_[i]))
+            {
+               pos_args_.emplace_back(args_[i]);
+               continue;
+            }
+            auto name = trim_leading_dashes(args_[i]);
+            auto equalPos = name.find('=');
+            if (equalPos != std::string::npos)
+            {
+               params_.insert({ name.substr(0, equalPos), name.substr(equalPos + 1) });
+               continue;
+            }
+            // the lookahead: the next arg is probed here and again as args_[i] on the next iteration
+            if (i == args_.size() - 1 || is_option(args_[i + 1]))
+            {
+               flags_.emplace(name);
+               continue;
+            }
+            flags_.emplace(name); // PREFER_FLAG_FOR_UNREG_OPTION, nothing is registered
+         }
+      }
+   };
+
+   enum class mix { flags, params, positional, mixed };
+
+   char const* mix_name(mix m)
+   {
+      switch (m)
+      {
+      case mix::flags:      return "flags";
+      case mix::params:     return "params";
+      case mix::positional: return "positional";
+      default:              return "mixed";
+      }
+   }
+
+   char const* mode_name(int mode)
+   {
+      switch (mode)
+      {
+      case argh::PREFER_FLAG_FOR_UNREG_OPTION:  return "PREFER_FLAG_FOR_UNREG_OPTION";
+      case argh::PREFER_PARAM_FOR_UNREG_OPTION: return "PREFER_PARAM_FOR_UNREG_OPTION";
+      case argh::SINGLE_DASH_IS_MULTIFLAG:      return "SINGLE_DASH_IS_MULTIFLAG";
+      case argh::NO_SPLIT_ON_EQUALSIGN:         return "NO_SPLIT_ON_EQUALSIGN";
+      default:                                  return "?";
+      }
+   }
+
+   template<typename CharType> char const* char_name();
+   template<> char const* char_name<char>()     { return "char"; }
+   template<> char const* char_name<wchar_t>()  { return "wchar_t"; }
+   template<> char const* char_name<char16_t>() { return "char16_t"; }
+   template<> char const* char_name<char32_t>() { return "char32_t"; }
+
+   template<typename CharType>
+   std::basic_string<CharType> widen(std::string const& str)
+   {
+      return std::basic_string<CharType>(str.begin(), str.end());
+   }
+
+   // synthetic command line of 'count' tokens, ASCII so that every CharType gets the same content
+   template<typename CharType>
+   std::vector<std::basic_string<CharType>> make_tokens(size_t count, mix m)
+   {
+      std::vector<std::basic_string<CharType>> tokens;
+      tokens.reserve(count);
+      for (size_t i = 0; tokens.size() < count; ++i)
+      {
+         auto n = std::to_string(i);
+         switch (m)
+         {
+         case mix::flags:
+            tokens.push_back(widen<CharType>(0 == i % 2 ? "--flag-" + n : "-xvf"));
+            break;
+         case mix::params:
+            tokens.push_back(widen<CharType>(0 == i % 3 ? "--param-" + n + "=" + n : "-p" + n));
+            if (tokens.size() < count && 0 != i % 3)
+               tokens.push_back(widen<CharType>(n + ".5"));
+            break;
+         case mix::positional:
+            tokens.push_back(widen<CharType>(0 == i % 4 ? "-" + n + "e-3" : "/data/inputs/file_" + n + ".txt"));
+            break;
+         case mix::mixed:
+            switch (i % 5)
+            {
+            case 0: tokens.push_back(widen<CharType>("--option-" + n + "=" + n)); break;
+            case 1: tokens.push_back(widen<CharType>("-f" + n)); break;
+            case 2: tokens.push_back(widen<CharType>("-" + n + ".5e-3")); break;
+            case 3: tokens.push_back(widen<CharType>("/data/inputs/file_" + n + ".txt")); break;
+            default: tokens.push_back(widen<CharType>("--verbose")); break;
+            }
+            break;
+         }
+      }
+      return tokens;
+   }
+
+   template<typename CharType>
+   std::vector<const CharType*> make_argv(std::vector<std::basic_string<CharType>> const& tokens)
+   {
+      std::vector<const CharType*> argv;
+      for (auto& token : tokens)
+         argv.push_back(token.c_str());
+      return argv;
+   }
+
+   struct result
+   {
+      double ns = 0;         // per unit of work
+      double allocs = 0;     // per run
+   };
+
+   // runs fn repeatedly for at least min_seconds
+   template<typename Fn>
+   result measure(size_t units_per_run, Fn fn)
+   {
+      using clock = std::chrono::steady_clock;
+      size_t runs = 0, allocs = 0;
+      auto start = clock::now();
+      std::chrono::duration<double> elapsed{};
+      do
+      {
+         auto before = allocations;
+         fn();
+         allocs += allocations - before;
+         ++runs;
+         elapsed = clock::now() - start;
+      } while (elapsed.count() < min_seconds);
+
+      return { elapsed.count() * 1e9 / double(runs * units_per_run), double(allocs) / double(runs) };
+   }
+
+   void report(char const* what, char const* variant, size_t tokens, result const& r, char const* unit = "token")
+   {
+      std::printf("%-46s %-26s %7zu tokens %9.1f ns/%-6s %11.1f allocs\n", what, variant, tokens, r.ns, unit, r.allocs);
+   }
+
+   template<typename Parser, typename CharType>
+   result parse_cost(std::vector<const CharType*> const& argv, int mode)
+   {
+      return measure(argv.size(), [&] { Parser p; p.parse(argv.size(), argv.data(), mode); });
+   }
+
+   std::vector<size_t> sizes = { 10, 1000, 100000 };
+
+   void bench_legacy()
+   {
+      for (size_t count : sizes)
+      {
+         auto tokens = make_tokens<char>(count, mix::mixed);
+         auto argv = make_argv(tokens);
+         report("legacy stream-probing loop", "mixed", count, measure(count, [&] { legacy_parser p; p.parse(argv.size(), argv.data()); }));
+      }
+   }
+
+   void bench_mixes()
+   {
+      for (mix m : { mix::flags, mix::params, mix::positional, mix::mixed })
+         for (size_t count : sizes)
+         {
+            auto tokens = make_tokens<char>(count, m);
+            auto argv = make_argv(tokens);
+            report("parse parser<char>", mix_name(m), count, parse_cost<argh::parser<>>(argv, argh::PREFER_FLAG_FOR_UNREG_OPTION));
+            report("parse view_parser<char>", mix_name(m), count, parse_cost<argh::view_parser<>>(argv, argh::PREFER_FLAG_FOR_UNREG_OPTION));
+            report("parse view_parser<char, flat_storage>", mix_name(m), count,
+               parse_cost<argh::view_parser<char, argh::flat_storage>>(argv, argh::PREFER_FLAG_FOR_UNREG_OPTION));
+         }
+   }
+
+   void bench_modes()
+   {
+      for (int mode : { argh::PREFER_FLAG_FOR_UNREG_OPTION, argh::PREFER_PARAM_FOR_UNREG_OPTION,
+                        argh::SINGLE_DASH_IS_MULTIFLAG, argh::NO_SPLIT_ON_EQUALSIGN })
+         for (size_t count : sizes)
+         {
+            auto tokens = make_tokens<char>(count, mix::mixed);
+            auto argv = make_argv(tokens);
+            report("parse parser<char>", mode_name(mode), count, parse_cost<argh::parser<>>(argv, mode));
+         }
+   }
+
+   template<typename CharType>
+   void bench_char_type()
+   {
+      std::string what = std::string("parse parser<") + char_name<CharType>() + ">";
+      std::string view_what = std::string("parse view_parser<") + char_name<CharType>() + ">";
+      for (size_t count : sizes)
+      {
+         auto tokens = make_tokens<CharType>(count, mix::mixed);
+         auto argv = make_argv(tokens);
+         report(what.c_str(), "mixed", count, parse_cost<argh::parser<CharType>>(argv, argh::PREFER_FLAG_FOR_UNREG_OPTION));
+         report(view_what.c_str(), "mixed", count, parse_cost<argh::view_parser<CharType>>(argv, argh::PREFER_FLAG_FOR_UNREG_OPTION));
+      }
+   }
+
+   // one parser per worker, reparsed for every command line. Returns false if a parser that should
+   // have reached a steady state still allocates.
+   template<typename Parser>
+   bool bench_reparse(char const* variant, bool expect_no_allocs)
+   {
+      bool ok = true;
+      for (size_t count : sizes)
+      {
+         auto tokens = make_tokens<char>(count, mix::mixed);
+         auto argv = make_argv(tokens);
+         Parser p;
+         p.parse(argv.size(), argv.data()); // warm up, capacity grows to fit
+         auto r = measure(count, [&] { p.reparse(argv.size(), argv.data()); });
+         report("reparse one parser", variant, count, r);
+         if (expect_no_allocs && 0 != r.allocs)
+         {
+            std::printf("FAILED: %s allocates in steady state\n", variant);
+            ok = false;
+         }
+      }
+      return ok;
+   }
+
+   // a tool reading two options at the front of a long argv
+   void bench_lazy()
+   {
+      for (size_t count : sizes)
+      {
+         auto tokens = make_tokens<char>(count, mix::mixed);
+         auto argv = make_argv(tokens);
+         for (int mode : { 0, int(argh::LAZY_PARSE) })
+            report("parse + 2 lookups view_parser<char>", mode ? "mixed, LAZY_PARSE" : "mixed, eager", count, measure(count, [&]
+            {
+               argh::view_parser<> p;
+               p.parse(argv.size(), argv.data(), argh::PREFER_FLAG_FOR_UNREG_OPTION | mode);
+               if (!p("option-0") || !p["f1"])
+                  std::printf("?");
+            }));
+
+         // the same args as events, nothing stored
+         struct counter
+         {
+            size_t events = 0;
+            void on_positional(std::string_view)             { ++events; }
+            void on_flag(std::string_view)                   { ++events; }
+            void on_param(std::string_view, std::string_view) { ++events; }
+         };
+         argh::view_parser<> visiting;
+         report("visit view_parser<char>", "mixed", count, measure(count, [&]
+         {
+            counter c;
+            visiting.visit(argv.size(), argv.data(), c);
+            if (0 == c.events)
+               std::printf("?");
+         }));
+         report("feed parser<char>", "mixed", count, measure(count, [&]
+         {
+            argh::parser<> p;
+            for (auto arg : argv)
+               p.feed(arg);
+            p.finish();
+         }));
+      }
+   }
+
+   // a cached snapshot (load() of a saved blob, keyed by hash_args()) against parsing the args
+   void bench_snapshot_load()
+   {
+      char const* path = "argh_bench_snapshot.bin";
+      for (size_t count : sizes)
+      {
+         auto tokens = make_tokens<char>(count, mix::mixed);
+         auto argv = make_argv(tokens);
+         {
+            argh::parser<> p;
+            p.parse(argv.size(), argv.data());
+            p.freeze(argh::hash_args(argv.size(), argv.data()))->save(path);
+         }
+         report("parse + 2 lookups parser<char>", "mixed", count, measure(count, [&]
+         {
+            argh::parser<> p;
+            p.parse(argv.size(), argv.data());
+            if (!p("option-0") || !p["f1"])
+               std::printf("?");
+         }));
+         report("load snapshot + 2 lookups", "mixed", count, measure(count, [&]
+         {
+            auto s = argh::snapshot<>::load(path, argh::hash_args(argv.size(), argv.data()));
+            if (!s || !s->param("option-0") || !(*s)["f1"])
+               std::printf("?");
+         }));
+      }
+      std::remove(path);
+   }
+
+   // load_config() of a generated INI file, against the same entries as argv
+   void bench_config_load()
+   {
+      char const* path = "argh_bench_config.ini";
+      for (size_t count : sizes)
+      {
+         std::string text = "[section]\n";
+         for (size_t i = 0; i < count; ++i)
+            text += "option-" + std::to_string(i) + " = " + std::to_string(i * 7) + "\n";
+         std::FILE* file = std::fopen(path, "wb");
+         std::fwrite(text.data(), 1, text.size(), file);
+         std::fclose(file);
+
+         report("load_config view_parser<char>", "key = value", count, measure(count, [&]
+         {
+            argh::view_parser<> p;
+            if (!p.load_config(path) || !p("section.option-0"))
+               std::printf("?");
+         }), "line");
+         report("load_config parser<char>", "key = value", count, measure(count, [&]
+         {
+            argh::parser<> p;
+            if (!p.load_config(path) || !p("section.option-0"))
+               std::printf("?");
+         }), "line");
+      }
+      std::remove(path);
+   }
+
+   // add_param() one name at a time, then a lookup (which indexes the names)
+   void bench_registration()
+   {
+      for (size_t count : sizes)
+      {
+         std::vector<std::string> names;
+         for (size_t i = 0; i < count; ++i)
+            names.push_back("option-" + std::to_string(i));
+         report("add_param + match parser<char>", "one at a time", count, measure(count, [&]
+         {
+            argh::parser<> p;
+            for (auto const& name : names)
+               p.add_param(name);
+            if (!p.match("option-0").name.size())
+               std::printf("?");
+         }), "param");
+      }
+   }
+
+   // completing a word against thousands of options; every keypress is a new process, so a request
+   // sets up the parser before it completes: registering each option at run time, or pointing it at
+   // a schema, which a program builds at compile time (it is built once here, outside the timing)
+   void bench_completion()
+   {
+      constexpr size_t options = 5000;
+      static std::vector<std::string> names;
+      static argh::option_spec<char> specs[options];
+      names.reserve(options); // the specs view the names
+      for (size_t i = 0; i < options; ++i)
+      {
+         names.push_back("option-" + std::to_string(i));
+         specs[i] = { names.back(), i % 2 ? argh::option_kind::flag : argh::option_kind::param };
+      }
+      static auto const schema = std::make_unique<argh::basic_schema<char, options>>(specs);
+
+      for (char const* word : { "--option-123", "--option-1", "--zz" })
+      {
+         char const* argv[] = { "prog", "-v", word, nullptr };
+         size_t candidates = 0;
+         argh::parser<> counted(*schema);
+         counted.complete(3, argv, 2, [&](std::string_view, std::string_view, bool) { ++candidates; });
+
+         std::ostringstream out;
+         report("add_param + write_completions, 5000 options", word, candidates, measure(1, [&]
+         {
+            argh::parser<> p;
+            for (auto const& name : names)
+               p.add_param(name);
+            out.str(std::string());
+            p.write_completions(out, argh::shell::bash, 3, argv, 2);
+         }), "request");
+         report("schema + write_completions, 5000 options", word, candidates, measure(1, [&]
+         {
+            argh::parser<> p(*schema);
+            out.str(std::string());
+            p.write_completions(out, argh::shell::bash, 3, argv, 2);
+         }), "request");
+      }
+   }
+
+   // a few very long tokens, where the '=' and dash scans dominate (compare with -DARGH_NO_SIMD)
+   void bench_long_tokens()
+   {
+      for (size_t length : { 64, 4096, 65536 })
+      {
+         std::vector<std::string> tokens = { "--payload=" + std::string(length, 'Q'), "--" + std::string(length, 'j'), "-v" };
+         auto argv = make_argv(tokens);
+         report("parse view_parser<char>", ("long tokens, " + std::to_string(length)).c_str(), argv.size(),
+            parse_cost<argh::view_parser<>>(argv, argh::PREFER_FLAG_FOR_UNREG_OPTION));
+         auto wide = std::vector<std::u16string>{ widen<char16_t>(tokens[0]), widen<char16_t>(tokens[1]), u"-v" };
+         auto wargv = make_argv(wide);
+         report("parse view_parser<char16_t>", ("long tokens, " + std::to_string(length)).c_str(), wargv.size(),
+            parse_cost<argh::view_parser<char16_t>>(wargv, argh::PREFER_FLAG_FOR_UNREG_OPTION));
+      }
+   }
+
+   // many short command lines: one parser per line against parse_batch()
+   void bench_batch()
+   {
+      size_t const lines = sizes.back(), per_line = 10;
+      std::vector<std::vector<std::string>> storage;
+      std::vector<std::vector<const char*>> argvs;
+      for (size_t l = 0; l < lines; ++l)
+      {
+         storage.push_back(make_tokens<char>(per_line, mix::mixed));
+         argvs.push_back(make_argv(storage.back()));
+      }
+      std::vector<argh::command_line<char>> batch;
+      for (auto& argv : argvs)
+         batch.push_back({ argv.size(), argv.data() });
+
+      argh::parser<> config({ "option-0", "f1" });
+      size_t const tokens = lines * per_line;
+      report("parser<char> per line", "mixed", tokens, measure(tokens, [&]
+      {
+         for (auto& line : batch)
+         {
+            argh::parser<> p({ "option-0", "f1" });
+            p.parse(line.argc, line.argv);
+         }
+      }));
+      report("parse_batch", "mixed, 1 thread", tokens, measure(tokens, [&] { config.parse_batch(batch, argh::PREFER_FLAG_FOR_UNREG_OPTION, 1); }));
+      report("parse_batch", "mixed, all threads", tokens, measure(tokens, [&] { config.parse_batch(batch); }));
+   }
+
+   template<typename Parser>
+   void bench_lookups(char const* variant)
+   {
+      size_t const count = 1000;
+      auto tokens = make_tokens<char>(count, mix::mixed);
+      auto argv = make_argv(tokens);
+      Parser p;
+      p.parse(argv.size(), argv.data());
+
+      // hits and misses, alternating
+      std::vector<std::string> flag_names = { "verbose", "f1", "missing", "-f6" };
+      std::vector<std::string> param_names = { "option-0", "--option-5", "missing", "option-10" };
+      size_t const lookups = 4000;
+      size_t hits = 0;
+
+      auto flags = measure(lookups, [&] { for (size_t i = 0; i < lookups; ++i) hits += p[flag_names[i % 4]]; });
+      report("lookup operator[](name)", variant, count, { flags.ns, flags.allocs / lookups }, "lookup");
+
+      auto literal = measure(lookups, [&] { for (size_t i = 0; i < lookups; ++i) hits += p["verbose"]; });
+      report("lookup operator[](literal)", variant, count, { literal.ns, literal.allocs / lookups }, "lookup");
+
+      auto streams = measure(lookups, [&] { for (size_t i = 0; i < lookups; ++i) { int v = 0; hits += !!(p(param_names[i % 4]) >> v); } });
+      report("lookup operator()(name) >> int", variant, count, { streams.ns, streams.allocs / lookups }, "lookup");
+
+      auto typed = measure(lookups, [&] { for (size_t i = 0; i < lookups; ++i) hits += p.get(param_names[i % 4], 0); });
+      report("lookup get<int>(name, def)", variant, count, { typed.ns, typed.allocs / lookups }, "lookup");
+
+      argh::option_handle flag_handles[] = { p.intern("verbose"), p.intern("f1"), p.intern("missing"), p.intern("-f6") };
+      argh::option_handle param_handles[] = { p.intern("option-0"), p.intern("--option-5"), p.intern("missing"), p.intern("option-10") };
+      auto handle_flags = measure(lookups, [&] { for (size_t i = 0; i < lookups; ++i) hits += p[flag_handles[i % 4]]; });
+      report("lookup operator[](handle)", variant, count, { handle_flags.ns, handle_flags.allocs / lookups }, "lookup");
+
+      auto handle_typed = measure(lookups, [&] { for (size_t i = 0; i < lookups; ++i) hits += p.get(param_handles[i % 4], 0); });
+      report("lookup get<int>(handle, def)", variant, count, { handle_typed.ns, handle_typed.allocs / lookups }, "lookup");
+
+      auto cached = measure(lookups, [&] { for (size_t i = 0; i < lookups; ++i) hits += p.cached(param_names[i % 4], 0); });
+      report("lookup cached<int>(name, def)", variant, count, { cached.ns, cached.allocs / lookups }, "lookup");
+
+      auto handle_cached = measure(lookups, [&] { for (size_t i = 0; i < lookups; ++i) hits += p.cached(param_handles[i % 4], 0); });
+      report("lookup cached<int>(handle, def)", variant, count, { handle_cached.ns, handle_cached.allocs / lookups }, "lookup");
+
+      auto frozen = p.freeze();
+      auto snapshot_flags = measure(lookups, [&] { for (size_t i = 0; i < lookups; ++i) hits += (*frozen)[flag_names[i % 4]]; });
+      report("lookup snapshot[](name)", variant, count, { snapshot_flags.ns, snapshot_flags.allocs / lookups }, "lookup");
+
+      auto snapshot_typed = measure(lookups, [&] { for (size_t i = 0; i < lookups; ++i) hits += frozen->get(param_names[i % 4], 0); });
+      report("lookup snapshot get<int>(name, def)", variant, count, { snapshot_typed.ns, snapshot_typed.allocs / lookups }, "lookup");
+
+      if (0 == hits)
+         std::printf("(no hits)\n");
+   }
+}
+
+int main(int argc, char* argv[])
+{
+   argh::parser<> cmdl(argc, argv);
+   if (cmdl["quick"])
+   {
+      min_seconds = 0.02;
+      sizes = { 10, 1000 };
+   }
+
+   bench_legacy();
+   bench_mixes();
+   bench_modes();
+   bench_char_type<char>();
+   bench_char_type<wchar_t>();
+   bench_char_type<char16_t>();
+   bench_char_type<char32_t>();
+   bool ok = bench_reparse<argh::view_parser<char, argh::flat_storage>>("view_parser<char, flat_storage>", true);
+   ok = bench_reparse<argh::view_parser<>>("view_parser<char>", false) && ok;
+   ok = bench_reparse<argh::parser<char, std::string, argh::flat_storage>>("parser<char, flat_storage>", false) && ok;
+   bench_lazy();
+   bench_long_tokens();
+   bench_snapshot_load();
+   bench_config_load();
+   bench_registration();
+   bench_completion();
+   bench_batch();
+   bench_lookups<argh::parser<>>("parser<char>");
+   bench_lookups<argh::view_parser<>>("view_parser<char>");
+   bench_lookups<argh::parser<char, std::string, argh::flat_storage>>("parser<char, flat_storage>");
+   return ok ? 0 : 1;
+}
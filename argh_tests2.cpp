@@ -120,6 +120,52 @@ TEST_CASE("Test negative numbers are not options")
     CHECK(0 == cmdl.flags().size());
 }
 
+TEST_CASE("Test numeric classification matches stream extraction")
+{
+    {
+        const char* argv[] = { "-.5", "-1.e5", "-5abc", "-0x10", "-1e-999", "-1.7976931348623157e308" };
+        int argc = sizeof(argv) / sizeof(argv[0]);
+        parser cmdl(argc, argv);
+        CHECK(static_cast<size_t>(argc) == cmdl.pos_args().size());
+        CHECK(0 == cmdl.flags().size());
+    }
+    {
+        // not numbers for operator>>, hence options
+        const char* argv[] = { "-inf", "-nan", "-1e", "-1e+", "-.", "--5", "-1e999", "-1.7976931348623159e308" };
+        int argc = sizeof(argv) / sizeof(argv[0]);
+        parser cmdl(argc, argv);
+        CHECK(0 == cmdl.pos_args().size());
+        CHECK(cmdl["inf"]);
+        CHECK(cmdl["nan"]);
+        CHECK(cmdl["1e"]);
+        CHECK(cmdl["1e+"]);
+        CHECK(cmdl["5"]);
+        CHECK(cmdl["1e999"]);
+    }
+    {
+        // borderline magnitudes longer than the stack buffer: the exponent still counts
+        std::string const huge = "-1.8" + std::string(600, '0') + "e308";
+        std::u16string const wide_huge(huge.begin(), huge.end());
+        const char* argv[] = { huge.c_str() };
+        parser cmdl(1, argv);
+        CHECK(0 == cmdl.pos_args().size());
+        const char16_t* wargv[] = { wide_huge.c_str() };
+        parser<char16_t> wide(1, wargv);
+        CHECK(0 == wide.pos_args().size());
+        std::string const fits = "-1.7" + std::string(600, '0') + "e308";
+        const char* fits_argv[] = { fits.c_str() };
+        CHECK(1 == parser(1, fits_argv).pos_args().size());
+    }
+    {
+        const wchar_t* argv[] = { L"-1", L"-a", L"-1.3e-2", L"-inf" };
+        int argc = sizeof(argv) / sizeof(argv[0]);
+        parser<wchar_t> cmdl(argc, argv, argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION);
+        CHECK(1 == cmdl.pos_args().size());
+        CHECK(cmdl(L"a").str() == L"-1.3e-2");
+        CHECK(cmdl[L"inf"]);
+    }
+}
+
 TEST_CASE("Test failed istream access")
 {
     const char* argv[] = { "-string", "Hello" };
@@ -235,6 +281,116 @@ TEST_CASE("Test default value")
     CHECK(pi == pi_val);
 }
 
+struct point
+{
+   int x = 0, y = 0;
+};
+
+std::istream& operator>>(std::istream& is, point& p)
+{
+   char comma;
+   return is >> p.x >> comma >> p.y;
+}
+
+TEST_CASE("Test typed accessors")
+{
+   const char* argv[] = { "12", "pos", "-n=42", "-pi=3.25", "-big=1e999", "-neg=-7", "-plus=+5", "-ws=  9",
+                          "-b=1", "-nb=2", "-s=hello world", "-e=", "-pt=3,4", "-c=xyz", "-inf=inf", "-nan=-nan",
+                          "-exp=1e", "-sign=1e+", "-twice=1e5e", "-tiny=-1e-999", nullptr };
+   parser cmdl(argv);
+
+   CHECK(cmdl.try_get<int>("n") == 42);
+   CHECK(cmdl.try_get<long long>("--n") == 42LL);
+   CHECK(cmdl.try_get<double>("pi") == 3.25);
+   CHECK(cmdl.try_get<long double>("pi") == 3.25L);
+   CHECK(cmdl.try_get<float>("pi") == 3.25f);
+   CHECK(!cmdl.try_get<double>("big"));
+   CHECK(cmdl.try_get<int>("neg") == -7);
+   CHECK(!cmdl.try_get<unsigned>("neg"));
+   CHECK(cmdl.try_get<int>("plus") == 5);
+   CHECK(cmdl.try_get<int>("ws") == 9);
+   CHECK(cmdl.try_get<int>("pi") == 3); // numeric prefix, as with operator>>
+   CHECK(!cmdl.try_get<int>("s"));
+   CHECK(!cmdl.try_get<int>("e"));
+   CHECK(!cmdl.try_get<int>("missing"));
+
+   // what operator>> rejects or reads differently
+   for (auto name : { "inf", "nan", "exp", "sign" })
+   {
+      double streamed;
+      CHECK(!(cmdl(name) >> streamed));
+      CHECK(!cmdl.try_get<double>(name));
+      CHECK(!cmdl.try_get<float>(name));
+   }
+   CHECK(cmdl.try_get<int>("exp") == 1);
+   CHECK(cmdl.try_get<double>("twice") == 1e5);
+   CHECK(cmdl.try_get<double>("tiny") == 0.0);
+
+   CHECK(cmdl.try_get<bool>("b") == true);
+   CHECK(!cmdl.try_get<bool>("nb"));
+   CHECK(cmdl.try_get<char>("c") == 'x');
+
+   CHECK(cmdl.try_get<std::string>("s") == std::string("hello world"));
+   CHECK(cmdl.try_get<std::string_view>("s") == std::string_view("hello world"));
+   CHECK(cmdl.try_get<std::string>("e") == std::string());
+
+   auto pt = cmdl.try_get<point>("pt");
+   REQUIRE(pt);
+   CHECK(3 == pt->x);
+   CHECK(4 == pt->y);
+   CHECK(!cmdl.try_get<point>("s"));
+
+   // defaults are returned as-is
+   CHECK(42 == cmdl.get("n", 7));
+   CHECK(7 == cmdl.get("missing", 7));
+   CHECK(7 == cmdl.get("s", 7));
+   double pi = 3.1415926535897932384626433832795028841971693993751058209749445;
+   CHECK(pi == cmdl.get("missing", pi));
+   CHECK(cmdl.get<std::string>("missing", "dflt") == "dflt");
+   CHECK(cmdl.get("missing", "dflt") == "dflt"); // a std::string, not a pointer
+   CHECK(cmdl.get("s", "dflt") == "hello world");
+   CHECK(cmdl.get(1, "") == "pos");
+
+   // positional
+   CHECK(cmdl.try_get<int>(0) == 12);
+   CHECK(!cmdl.try_get<int>(1));
+   CHECK(!cmdl.try_get<int>(2));
+   CHECK(12 == cmdl.get(0, 7));
+   CHECK(7 == cmdl.get(5, 7));
+   CHECK(cmdl.get<std::string>(1, "") == "pos");
+}
+
+TEST_CASE("Test wide typed accessors")
+{
+   {
+      const wchar_t* argv[] = { L"-n=42", L"-pi=-2.5e1", L"-s=x y", L"-u=4\u00e9", nullptr };
+      parser<wchar_t> cmdl(argv);
+      CHECK(cmdl.try_get<int>(L"n") == 42);
+      CHECK(cmdl.try_get<double>(L"pi") == -25.0);
+      CHECK(cmdl.try_get<std::wstring>(L"s") == std::wstring(L"x y"));
+      CHECK(cmdl.try_get<int>(L"u") == 4);
+      CHECK(3 == cmdl.get(L"missing", 3));
+   }
+   {
+      const char32_t* argv[] = { U"-n=42", U"-pi=0.5", U"7", nullptr };
+      parser<char32_t> cmdl(argv);
+      CHECK(cmdl.try_get<int>(U"n") == 42);
+      CHECK(cmdl.try_get<double>(U"pi") == 0.5);
+      CHECK(cmdl.try_get<unsigned>(0) == 7u);
+      CHECK(cmdl.try_get<std::u32string>(U"n") == std::u32string(U"42"));
+   }
+   {
+      std::u16string digits(300, u'1');
+      std::u16string arg = u"-long=0." + digits;
+      const char16_t* argv[] = { arg.c_str(), nullptr };
+      parser<char16_t> cmdl(argv);
+      auto value = cmdl.try_get<double>(u"long");
+      REQUIRE(value);
+      CHECK(*value > 0.11);
+      CHECK(*value < 0.12);
+   }
+}
+
 TEST_CASE("Leading dashed are stripped")
 {
     parser cmdl;
@@ -262,6 +418,54 @@ TEST_CASE("Leading dashed are stripped")
     CHECK(cmdl["---w"]);
 }
 
+TEST_CASE("Dash-only, slash and empty tokens")
+{
+   const char* argv[] = { "-", "---", "/win", "//x=1", "", "-=v", nullptr };
+   parser cmdl(argv);
+   CHECK(cmdl["-"]);
+   CHECK(cmdl.flags().count("---"));
+   CHECK(cmdl["win"]);
+   CHECK(cmdl("x").str() == "1");
+   CHECK(cmdl("").str() == "v");
+   CHECK(1 == cmdl.size());
+   CHECK(cmdl[0].empty());
+}
+
+template<typename CharType>
+static size_t scanning_mismatches()
+{
+   size_t mismatches = 0;
+   for (size_t n = 0; n < 80; ++n)
+      for (size_t at = 0; at <= n; ++at)
+      {
+         // a run of '-' up to 'at', then '=' at 'at' and more after it
+         std::basic_string<CharType> str(n, CharType('-'));
+         for (size_t i = at; i < n; ++i)
+            str[i] = 0 == (i - at) % 3 ? CharType('=') : CharType(1 < sizeof(CharType) ? 0x263A : 'x');
+         mismatches += argh::detail::find_char<false>(str.data(), n, CharType('-')) != at;
+         mismatches += argh::detail::find_char<true>(str.data(), n, CharType('=')) != at;
+         mismatches += argh::detail::find_char<true>(str.data(), at, CharType('=')) != at;
+         mismatches += argh::detail::length(str.c_str() + at) != n - at;
+      }
+   return mismatches;
+}
+
+TEST_CASE("Long tokens are scanned in blocks")
+{
+   CHECK(0 == scanning_mismatches<char>());
+   CHECK(0 == scanning_mismatches<wchar_t>());
+   CHECK(0 == scanning_mismatches<char16_t>());
+   CHECK(0 == scanning_mismatches<char32_t>());
+
+   std::string payload(5000, 'A');
+   auto arg = "--payload=" + payload + "=";
+   auto dashes = "----" + std::string(100, '-') + "x=" + payload;
+   const char* argv[] = { arg.c_str(), dashes.c_str(), nullptr };
+   argh::view_parser<> cmdl(argv);
+   CHECK(cmdl("payload").str() == payload + "=");
+   CHECK(cmdl("x").str() == payload);
+}
+
 TEST_CASE("Split parameter at '='")
 {
     {
@@ -806,6 +1010,1314 @@ TEST_CASE("Test size() member function")
    }
 }
 
+TEST_CASE("Test zero-copy view parser")
+{
+   const char* argv[] = { "0", "--answer=42", "-xvf", "pos", "-g", "456", "-e", nullptr };
+   argh::view_parser<> cmdl;
+   cmdl.add_param("g");
+   cmdl.parse(argv, argh::Mode::SINGLE_DASH_IS_MULTIFLAG);
+
+   CHECK(2 == cmdl.size());
+   CHECK(cmdl[0] == "0");
+   CHECK(cmdl[0].data() == argv[0]);
+   CHECK(cmdl[1].data() == argv[3]);
+   CHECK(cmdl[5].empty());
+
+   // '=' split and multi-flag split are sub-views of the original tokens
+   auto answer = cmdl.params().find("answer");
+   REQUIRE(answer != cmdl.params().end());
+   CHECK(answer->first.data() == argv[1] + 2);
+   CHECK(answer->second.data() == argv[1] + 9);
+   CHECK(cmdl("answer").str() == "42");
+
+   CHECK(cmdl["x"]);
+   CHECK(cmdl["v"]);
+   CHECK(cmdl["f"]);
+   CHECK(cmdl["e"]);
+   CHECK(cmdl("g").str() == "456");
+   CHECK(cmdl.params().find("g")->second.data() == argv[5]);
+
+   int val = 0;
+   CHECK((cmdl(0) >> val));
+   CHECK(0 == val);
+   CHECK((cmdl("g", 7) >> val));
+   CHECK(456 == val);
+   CHECK((cmdl("h", 7) >> val));
+   CHECK(7 == val);
+
+   argh::view_parser<wchar_t> wcmdl;
+   const wchar_t* wargv[] = { L"-a", L"--b=2", L"c", nullptr };
+   wcmdl.parse(wargv);
+   CHECK(wcmdl[L"a"]);
+   CHECK(wcmdl(L"b").str() == L"2");
+   CHECK(wcmdl[0].data() == wargv[2]);
+}
+
+TEST_CASE("Test lookup by literal, string and string_view")
+{
+   const char* argv[] = { "--threads=8", "-v", nullptr };
+   parser cmdl(argv);
+
+   std::string name = "--threads";
+   std::string_view view = "threads";
+   CHECK(cmdl("threads").str() == "8");
+   CHECK(cmdl(name).str() == "8");
+   CHECK(cmdl(view).str() == "8");
+   CHECK(cmdl(view.substr(0, 6)).str().empty());
+   CHECK(cmdl(std::string_view("--threads-x", 9)).str() == "8");
+
+   CHECK(cmdl["v"]);
+   CHECK(cmdl[std::string("-v")]);
+   CHECK(cmdl[std::string_view("--v")]);
+   CHECK(!cmdl[view]);
+
+   CHECK(cmdl.params().count(view));
+   CHECK(cmdl.flags().count(std::string_view("v")));
+}
+
+TEST_CASE("Test flat storage")
+{
+   const char* argv[] = { "0", "-b", "-a", "1", "-b", "--x=1", "-x=2", "-g", "456", "-zyc", "3", nullptr };
+   {
+      argh::parser<char, std::string, argh::flat_storage> cmdl;
+      cmdl.add_params({ "g", "c" });
+      cmdl.parse(argv, argh::Mode::SINGLE_DASH_IS_MULTIFLAG);
+
+      CHECK(2 == cmdl.size());
+      CHECK(cmdl[{"a"}]);
+      CHECK(cmdl["b"]);
+      CHECK(2 == cmdl.flags().count("b"));
+      CHECK(cmdl["z"]);
+      CHECK(cmdl["y"]);
+      CHECK(!cmdl["c"]);
+      CHECK(cmdl("c").str() == "3");
+      CHECK(cmdl("g").str() == "456");
+      CHECK(cmdl("x").str() == "1"); // first value wins, as with std::map
+      CHECK(cmdl.get("g", 0) == 456);
+      CHECK(!cmdl("b"));
+
+      // iteration is ordered by name
+      CHECK(std::is_sorted(cmdl.flags().begin(), cmdl.flags().end()));
+      CHECK(5 == cmdl.flags().size());
+      CHECK(3 == cmdl.params().size());
+      auto it = cmdl.params().begin();
+      CHECK(it->first == "c");
+      CHECK((++it)->first == "g");
+      CHECK((++it)->first == "x");
+   }
+   {
+      argh::view_parser<char, argh::flat_storage> cmdl(argv, argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION);
+      CHECK(cmdl("a").str() == "1");
+      CHECK(cmdl("x").str() == "1");
+      CHECK(cmdl("zyc").str() == "3");
+      CHECK(cmdl("g").str() == "456");
+      CHECK(cmdl.params().find("g")->second.data() == argv[8]);
+      CHECK(cmdl["b"]);
+      CHECK(cmdl[{ "a", "b" }]);
+      CHECK(!cmdl["a"]);
+      CHECK(2 == cmdl.flags().count("b"));
+   }
+}
+
+#if defined(ARGH_HAS_PMR)
+struct counting_resource : std::pmr::memory_resource
+{
+   size_t allocations = 0;
+
+   void* do_allocate(size_t bytes, size_t align) override
+   {
+      ++allocations;
+      return std::pmr::new_delete_resource()->allocate(bytes, align);
+   }
+   void do_deallocate(void* p, size_t bytes, size_t align) override
+   {
+      std::pmr::new_delete_resource()->deallocate(p, bytes, align);
+   }
+   bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override { return this == &other; }
+};
+
+TEST_CASE("Test pmr parser allocates from its memory resource")
+{
+   const char* argv[] = { "positional-argument-longer-than-sso", "--name-longer-than-the-sso-buffer=value-longer-than-the-sso-buffer",
+                          "-g", "456", "-flag-longer-than-the-sso-buffer", nullptr };
+
+   counting_resource upstream;
+   std::pmr::monotonic_buffer_resource arena(&upstream);
+   {
+      // anything not routed through the arena would hit the null resource and throw
+      auto previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+
+      argh::pmr::parser<> cmdl(&arena);
+      cmdl.add_param("g");
+      cmdl.parse(argv);
+
+      CHECK(cmdl.get_allocator().resource() == &arena);
+      CHECK(cmdl.params().get_allocator().resource() == &arena);
+      CHECK(cmdl.params().begin()->second.get_allocator().resource() == &arena);
+      CHECK(cmdl.pos_args().at(0).get_allocator().resource() == &arena);
+      CHECK(cmdl.flags().begin()->get_allocator().resource() == &arena);
+
+      CHECK(cmdl[0] == "positional-argument-longer-than-sso");
+      CHECK(cmdl("name-longer-than-the-sso-buffer").str() == "value-longer-than-the-sso-buffer");
+      CHECK(cmdl("g").str() == "456");
+      CHECK(cmdl["flag-longer-than-the-sso-buffer"]);
+
+      std::pmr::set_default_resource(previous);
+   }
+   {
+      argh::pmr::parser<char, argh::flat_storage> cmdl(&arena);
+      cmdl.parse(argv);
+      CHECK(cmdl.params().get_allocator().resource() == &arena);
+      CHECK(cmdl.params().begin()->first.get_allocator().resource() == &arena);
+      CHECK(cmdl["flag-longer-than-the-sso-buffer"]);
+   }
+   CHECK(0 < upstream.allocations);
+}
+#endif
+
+static constexpr auto test_schema = argh::make_schema({
+   { "threads", argh::option_kind::param, "t" },
+   { "verbose", argh::option_kind::flag,  "v" },
+   { "output",  argh::option_kind::param },
+   { "x",       argh::option_kind::flag },
+});
+
+static_assert(4 == test_schema.size());
+static_assert(0 == test_schema.index_of("threads"));
+static_assert(0 == test_schema.index_of("t"));
+static_assert(1 == test_schema.index_of("v"));
+static_assert(2 == test_schema.index_of("output"));
+static_assert(-1 == test_schema.index_of("out"));
+static_assert(-1 == test_schema.index_of(""));
+static_assert(argh::option_kind::flag == test_schema.find("verbose")->kind);
+static_assert(test_schema.by_name(0).name == "output" && test_schema.by_name(1).name == "threads");
+static_assert(test_schema.by_name(2).name == "verbose" && test_schema.by_name(3).name == "x");
+
+TEST_CASE("Test compile-time schema")
+{
+   {
+      const char* argv[] = { "-t", "8", "--verbose", "in", "--output=o.txt", "-x", "1", nullptr };
+      argh::parser<> cmdl(test_schema);
+      cmdl.parse(argv, argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION);
+
+      CHECK(cmdl("threads").str() == "8");
+      CHECK(cmdl("t").str() == "8"); // aliases resolve to the option name
+      CHECK(1 == cmdl.params().count("threads"));
+      CHECK(0 == cmdl.params().count("t"));
+      CHECK(cmdl["verbose"]);       // declared flag, "in" stays positional despite PREFER_PARAM
+      CHECK(cmdl["v"]);
+      CHECK(cmdl.get<std::string>("output", "") == "o.txt");
+      CHECK(cmdl["x"]);
+      CHECK(2 == cmdl.size());
+      CHECK(cmdl[0] == "in");
+      CHECK(cmdl[1] == "1");
+   }
+   {
+      // schema params win over PREFER_FLAG, and are not split as multi-flags
+      const char* argv[] = { "-vt", "4", "-output", "o.txt", nullptr };
+      argh::parser<> cmdl(test_schema);
+      cmdl.parse(argv, argh::Mode::SINGLE_DASH_IS_MULTIFLAG);
+      CHECK(cmdl["verbose"]);
+      CHECK(cmdl.get("threads", 0) == 4);
+      CHECK(cmdl("output").str() == "o.txt");
+      CHECK(0 == cmdl.size());
+   }
+   {
+      static constexpr auto wide_schema = argh::make_schema<wchar_t>({ { L"threads", argh::option_kind::param, L"t" } });
+      const wchar_t* argv[] = { L"-t", L"8", nullptr };
+      argh::view_parser<wchar_t> cmdl(wide_schema);
+      cmdl.parse(argv);
+      CHECK(cmdl(L"threads").str() == L"8");
+   }
+}
+
+namespace
+{
+   // writes a response file in the working directory, removed when it goes out of scope
+   struct temp_file
+   {
+      std::string path;
+      temp_file(std::string name, std::string const& contents) : path(std::move(name))
+      {
+         std::FILE* file = std::fopen(path.c_str(), "wb");
+         std::fwrite(contents.data(), 1, contents.size(), file);
+         std::fclose(file);
+      }
+      ~temp_file() { std::remove(path.c_str()); }
+   };
+
+   // sets an environment variable, removed when it goes out of scope
+   struct temp_env
+   {
+      std::string name;
+      temp_env(std::string variable, std::string const& value) : name(std::move(variable))
+      {
+#if defined(_WIN32)
+         _putenv_s(name.c_str(), value.c_str());
+#else
+         setenv(name.c_str(), value.c_str(), 1);
+#endif
+      }
+      ~temp_env()
+      {
+#if defined(_WIN32)
+         _putenv_s(name.c_str(), "");
+#else
+         unsetenv(name.c_str());
+#endif
+      }
+   };
+}
+
+TEST_CASE("Test response files")
+{
+   temp_file inner("argh_test_inner.rsp", "--depth=2 'quoted @arg'\n");
+   temp_file outer("argh_test_outer.rsp",
+                   "# build settings\n"
+                   "-t 8 --name \"a \\\"b\\\" c\"\r\n"
+                   "  in\\ file.txt @argh_test_inner.rsp\n"
+                   "'' last\n");
+   {
+      const char* argv[] = { "first", "@argh_test_outer.rsp", "@missing.rsp", "--tail", nullptr };
+      parser cmdl(argv, argh::Mode::EXPAND_RESPONSE_FILES | argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION);
+      CHECK(cmdl("t").str() == "8");
+      CHECK(cmdl("name").str() == "a \"b\" c");
+      CHECK(cmdl("depth").str() == "2");
+      CHECK(cmdl["tail"]);
+      CHECK(6 == cmdl.size());
+      CHECK(cmdl[0] == "first");
+      CHECK(cmdl[1] == "in file.txt");
+      CHECK(cmdl[2] == "quoted @arg"); // not a file name, it was quoted
+      CHECK(cmdl[3] == "");
+      CHECK(cmdl[4] == "last");
+      CHECK(cmdl[5] == "@missing.rsp");
+   }
+   {
+      // without the mode, @files are positional args
+      const char* argv[] = { "@argh_test_inner.rsp", nullptr };
+      parser cmdl(argv);
+      CHECK(cmdl[0] == "@argh_test_inner.rsp");
+   }
+   {
+      // views point into the file (or into the parser for unquoted args), copies keep them alive
+      const char* argv[] = { "@argh_test_outer.rsp", nullptr };
+      argh::view_parser<> copy;
+      {
+         argh::view_parser<> cmdl(argv, argh::Mode::EXPAND_RESPONSE_FILES | argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION);
+         copy = cmdl;
+      }
+      CHECK(copy("name").str() == "a \"b\" c");
+      CHECK(copy.get("t", 0) == 8);
+      CHECK(copy[0] == "in file.txt");
+   }
+   {
+      // wide parsers read UTF-8 files
+      temp_file wide("argh_test_wide.rsp", "--city=Z\xC3\xBCrich \xF0\x9F\x98\x80\n");
+      const wchar_t* wargv[] = { L"@argh_test_wide.rsp", nullptr };
+      argh::view_parser<wchar_t> wcmdl(wargv, argh::Mode::EXPAND_RESPONSE_FILES);
+      CHECK(wcmdl(L"city").str() == L"Zürich");
+      CHECK(wcmdl[0] == L"\U0001F600");
+
+      const char16_t* uargv[] = { u"@argh_test_wide.rsp", nullptr };
+      parser<char16_t> ucmdl(uargv, argh::Mode::EXPAND_RESPONSE_FILES);
+      CHECK(ucmdl[0] == u"\U0001F600");
+      CHECK(2 == ucmdl[0].size());
+   }
+   {
+      // a file naming itself stops at the depth limit
+      temp_file loop("argh_test_loop.rsp", "-x @argh_test_loop.rsp");
+      const char* argv[] = { "@argh_test_loop.rsp", nullptr };
+      parser cmdl(argv, argh::Mode::EXPAND_RESPONSE_FILES);
+      CHECK(1 == cmdl.size());
+      CHECK(cmdl[0] == "@argh_test_loop.rsp");
+   }
+}
+
+TEST_CASE("Test reset and reparse")
+{
+   const char* first[] = { "-a", "1", "--b=2", "-c", "x", "y", nullptr };
+   const char* second[] = { "-a", "3", "z", nullptr };
+   {
+      parser cmdl({ "a" });
+      cmdl.parse(first);
+      cmdl.parse(second); // parse() accumulates, the first value of 'a' wins
+      CHECK(cmdl("a").str() == "1");
+      CHECK(3 == cmdl.size());
+
+      cmdl.reparse(second);
+      CHECK(cmdl("a").str() == "3"); // still registered
+      CHECK(!cmdl("b"));
+      CHECK(!cmdl["c"]);
+      CHECK(1 == cmdl.size());
+      CHECK(cmdl[0] == "z");
+
+      cmdl.reset();
+      CHECK(0 == cmdl.size());
+      CHECK(cmdl.params().empty());
+      CHECK(cmdl.flags().empty());
+   }
+   {
+      argh::view_parser<char, argh::flat_storage> cmdl({ "a" });
+      for (int i = 0; i < 3; ++i)
+      {
+         cmdl.reparse(first);
+         CHECK(cmdl.get("a", 0) == 1);
+         CHECK(cmdl["c"]);
+         CHECK(2 == cmdl.size());
+#if defined(ARGH_ENABLE_STATS)
+         if (0 < i)
+            CHECK(0 == cmdl.stats().container_allocations); // capacity was kept
+#endif
+      }
+   }
+}
+
+TEST_CASE("Test batch parsing")
+{
+   std::vector<std::vector<std::string>> storage;
+   for (int i = 0; i < 1000; ++i)
+      storage.push_back({ "-t", std::to_string(i), "--verbose", "in" + std::to_string(i), "--out=" + std::to_string(i % 7), "-x" });
+   storage.push_back({});
+   storage.push_back({ "-v", "last" });
+
+   std::vector<std::vector<const char*>> argvs;
+   std::vector<argh::command_line<char>> lines;
+   for (auto& args : storage)
+   {
+      argvs.emplace_back();
+      for (auto& arg : args)
+         argvs.back().push_back(arg.c_str());
+   }
+   for (auto& argv : argvs)
+      lines.push_back({ argv.size(), argv.data() });
+
+   argh::parser<> config(test_schema);
+   for (unsigned threads : { 1u, 4u, 0u })
+   {
+      auto batch = config.parse_batch(lines, argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION, threads);
+      REQUIRE(lines.size() == batch.size());
+
+      size_t mismatches = 0;
+      for (size_t i = 0; i < lines.size(); ++i)
+      {
+         // same results as a parser of its own
+         argh::parser<> single(test_schema);
+         single.parse(lines[i].argc, lines[i].argv, argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION);
+         auto line = batch[i];
+         mismatches += line.size() != single.size() || line.flags().size() != single.flags().size()
+                    || line.params().size() != single.params().size();
+         for (size_t p = 0; p < single.size(); ++p)
+            mismatches += line[p] != single[p];
+         for (auto& param : single.params())
+            mismatches += line.param(param.first) != std::string_view(param.second);
+         for (auto& flag : single.flags())
+            mismatches += !line[flag];
+      }
+      CHECK(0 == mismatches);
+
+      auto line = batch[17];
+      CHECK(line.get("threads", 0) == 17);
+      CHECK(line.get("t", 0) == 17);
+      CHECK(line["-v"]);
+      CHECK(!line.param("output")); // "out" is not an alias
+      CHECK(line.param("out") == std::string_view("3"));
+      CHECK(!line.param("missing"));
+      CHECK(line[0] == "in17");
+      CHECK(line[1] == "");
+      CHECK(batch[1000].flags().empty());
+      CHECK(batch[1001]["verbose"]);
+      CHECK(batch[1001][0] == "last");
+      CHECK(1000 * 2 + 1 == batch.flags().size());
+   }
+}
+
+TEST_CASE("Test option handles")
+{
+   const char* argv[] = { "--level", "3", "-v", "--rate=0.25", "in", nullptr };
+   parser cmdl(test_schema);
+   auto level = cmdl.add_param("level");
+   auto rate = cmdl.intern("--rate");
+   auto verbose = cmdl.intern("v"); // alias, interned as "verbose"
+   auto missing = cmdl.intern("missing");
+   CHECK(cmdl.intern("-level").id == level.id);
+   CHECK(cmdl.intern("verbose").id == verbose.id);
+   CHECK(missing.id == 3); // ids in interning order, found by name in any order
+   CHECK(cmdl.intern("b").id == 4);
+   CHECK(cmdl.intern("a").id == 5);
+   CHECK(cmdl.intern("b").id == 4);
+   CHECK(!cmdl[verbose]);
+   CHECK(!cmdl(level));
+
+   cmdl.parse(argv);
+   CHECK(cmdl.get(level, 0) == 3);
+   CHECK(cmdl(level).str() == "3");
+   CHECK(cmdl.try_get<double>(rate) == 0.25);
+   CHECK(cmdl[verbose]);
+   CHECK(!cmdl[missing]);
+   CHECK(!cmdl(missing));
+   CHECK(!cmdl[argh::option_handle()]);
+   CHECK(cmdl.get(argh::option_handle(), 7) == 7);
+
+   // handles made after parse() see the results, copies keep their own values
+   auto in_flag = cmdl.intern("rate");
+   CHECK(in_flag.id == rate.id);
+   auto copy = cmdl;
+   cmdl.reparse(argv + 2);
+   CHECK(!cmdl(level));
+   CHECK(cmdl[verbose]);
+   CHECK(copy.get(level, 0) == 3);
+
+   argh::view_parser<> view({ "level" });
+   auto view_level = view.intern("level");
+   view.parse(argv);
+   CHECK(view.get<std::string_view>(view_level, "") == "3");
+}
+
+TEST_CASE("Test repeated params")
+{
+   const char* argv[] = { "-I", "a", "--define=X", "-I", "b", "-v", "--I=c", "--define=Y", "-t", "1", nullptr };
+   auto check = [](auto const& cmdl)
+   {
+      std::vector<std::string> includes(cmdl.values("I").begin(), cmdl.values("I").end());
+      CHECK(includes == std::vector<std::string>{ "a", "b", "c" });
+      CHECK(3 == cmdl.values("-I").size());
+      CHECK(cmdl("I").str() == "a"); // single value accessors keep the first one
+      CHECK(1 == cmdl.params().count("I"));
+      CHECK(2 == cmdl.values("define").size());
+      CHECK(*std::next(cmdl.values("define").begin()) == "Y");
+      CHECK(1 == cmdl.values("threads").size()); // by alias
+      CHECK(cmdl.values("missing").empty());
+      CHECK(cmdl.values("v").empty());
+   };
+   {
+      parser cmdl(test_schema);
+      cmdl.add_param("I");
+      cmdl.parse(argv);
+      check(cmdl);
+   }
+   {
+      argh::view_parser<char, argh::flat_storage> cmdl(test_schema);
+      cmdl.add_param("I");
+      cmdl.parse(argv);
+      check(cmdl);
+      CHECK(cmdl.values("I").begin()->data() == argv[1]); // views into argv
+
+      // values of later parse() calls follow, reparse() starts over
+      const char* more[] = { "--I=d", nullptr };
+      cmdl.parse(more);
+      CHECK(4 == cmdl.values("I").size());
+      cmdl.reparse(more);
+      CHECK(1 == cmdl.values("I").size());
+      CHECK(*cmdl.values("I").begin() == "d");
+   }
+   {
+      std::vector<std::string> storage;
+      for (int i = 0; i < 2000; ++i)
+         storage.push_back("--shard=" + std::to_string(i));
+      std::vector<const char*> shards;
+      for (auto& arg : storage)
+         shards.push_back(arg.c_str());
+      argh::view_parser<> cmdl(shards.size(), shards.data());
+      int expected = 0, mismatches = 0;
+      for (auto shard : cmdl.values("shard"))
+         mismatches += cmdl.get("shard", 0) + expected++ != std::stoi(std::string(shard));
+      CHECK(2000 == expected);
+      CHECK(0 == mismatches);
+   }
+}
+
+TEST_CASE("Test lazy parsing gives the eager answers")
+{
+   const char* argv[] = { "prog", "-v", "-t", "4", "--out=o.txt", "in1", "-abc", "-x", "-5", "in2", "--level", "2",
+                          "-I", "a", "-I", "b", "last", nullptr };
+   for (int mode : { int(argh::Mode::PREFER_FLAG_FOR_UNREG_OPTION), int(argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION),
+                     int(argh::Mode::SINGLE_DASH_IS_MULTIFLAG), int(argh::Mode::NO_SPLIT_ON_EQUALSIGN) })
+   {
+      argh::parser<char, std::string, argh::flat_storage> eager(test_schema);
+      eager.add_params({ "level", "I" });
+      eager.parse(argv, mode);
+
+      // one lazy parser per kind of first access, each touching the argv from a different end
+      for (int first_access = 0; first_access < 4; ++first_access)
+      {
+         argh::parser<char, std::string, argh::flat_storage> lazy(test_schema);
+         lazy.add_params({ "level", "I" });
+         auto level = lazy.intern("level");
+         lazy.parse(argv, mode | argh::Mode::LAZY_PARSE);
+
+         switch (first_access)
+         {
+         case 0: CHECK(lazy[0] == eager[0]); break;
+         case 1: CHECK(lazy["verbose"] == eager["verbose"]); break;
+         case 2: CHECK(lazy("level").str() == eager("level").str()); break;
+         default: CHECK(lazy[3] == eager[3]); break;
+         }
+         std::string const& first = lazy[0]; // must survive the rest of the lazy parse
+
+         CHECK(lazy["x"] == eager["x"]);
+         CHECK(lazy["a"] == eager["a"]);
+         CHECK(lazy["missing"] == eager["missing"]);
+         CHECK(lazy.get("threads", 0) == eager.get("threads", 0));
+         CHECK(lazy(1).str() == eager(1).str());
+         CHECK(lazy.get(2, 0) == eager.get(2, 0));
+         CHECK(lazy.try_get<int>(100) == eager.try_get<int>(100));
+         CHECK(lazy.get(level, 0) == eager.get("level", 0));
+         CHECK(lazy.values("I").size() == eager.values("I").size());
+         CHECK(lazy.size() == eager.size());
+         CHECK(std::equal(lazy.begin(), lazy.end(), eager.begin(), eager.end()));
+         CHECK(std::equal(lazy.flags().begin(), lazy.flags().end(), eager.flags().begin(), eager.flags().end()));
+         CHECK(std::equal(lazy.params().begin(), lazy.params().end(), eager.params().begin(), eager.params().end()));
+         CHECK(first == eager[0]);
+      }
+   }
+   {
+      // a lazy parse is completed before the next parse() replaces the args
+      const char* more[] = { "-t", "8", "z", nullptr };
+      parser cmdl(test_schema);
+      cmdl.parse(argv, argh::Mode::LAZY_PARSE);
+      CHECK(cmdl[0] == "prog");
+      cmdl.parse(more, argh::Mode::LAZY_PARSE);
+      CHECK(cmdl.get("t", 0) == 4);
+      CHECK(cmdl[cmdl.size() - 1] == "z");
+      const auto copy = cmdl;
+      CHECK(copy["verbose"]);
+   }
+}
+
+TEST_CASE("Test parsing owned strings")
+{
+   std::string const long_value = "a-value-long-enough-to-live-on-the-heap";
+   std::string const long_positional = "a-positional-long-enough-to-live-on-the-heap";
+   auto make_args = [&] { return std::vector<std::string>{ "prog", "-t", long_value, "--output=o.txt", long_positional, "-v" }; };
+   auto check = [&](auto const& cmdl)
+   {
+      CHECK(2 == cmdl.size());
+      CHECK(cmdl[1] == long_positional);
+      CHECK(cmdl("threads").str() == long_value);
+      CHECK(cmdl("output").str() == "o.txt");
+      CHECK(cmdl["verbose"]);
+   };
+
+   {
+      // moved all the way into the results, without another allocation
+      auto args = make_args();
+      auto const value_data = args[2].data(), positional_data = args[4].data();
+      parser cmdl(test_schema);
+      cmdl.parse(std::move(args));
+      check(cmdl);
+      CHECK(cmdl.pos_args()[1].data() == positional_data);
+      CHECK(cmdl.params().find("threads")->second.data() == value_data);
+   }
+   {
+      // lvalues are copied and left alone
+      auto const args = make_args();
+      parser cmdl(test_schema);
+      cmdl.parse(args);
+      check(cmdl);
+      CHECK(args == make_args());
+   }
+   {
+      // views point into the strings the parser keeps, copies share them
+      argh::view_parser<char, argh::flat_storage> cmdl(test_schema);
+      cmdl.parse(make_args());
+      auto const copy = cmdl;
+      cmdl.reset();
+      cmdl.parse(make_args(), argh::Mode::LAZY_PARSE);
+      check(copy);
+      check(cmdl);
+   }
+   {
+      std::vector<std::string_view> const args = { "prog", "-t", "4", "x" };
+      argh::view_parser<> cmdl(test_schema);
+      cmdl.parse(args);
+      CHECK(cmdl[1].data() == args[3].data());
+      CHECK(cmdl.get("threads", 0) == 4);
+   }
+}
+
+TEST_CASE("Test UTF accessors")
+{
+   // "na\u00efve \u20ac \U0001F600" in each encoding
+   std::string const utf8 = "na\xC3\xAFve \xE2\x82\xAC \xF0\x9F\x98\x80";
+   std::u16string const utf16 = u"na\u00efve \u20ac \U0001F600";
+   std::u32string const utf32 = U"na\u00efve \u20ac \U0001F600";
+   {
+      const char16_t* argv[] = { u"prog", u"--name", utf16.c_str(), utf16.c_str(), nullptr };
+      parser<char16_t> cmdl({ u"name" });
+      cmdl.parse(argv);
+      CHECK(cmdl.utf8(u"name") == utf8);
+      CHECK(cmdl.utf8(1) == utf8);
+      CHECK(cmdl.utf8(0) == "prog");
+      CHECK(cmdl.transcoded<char32_t>(u"name") == utf32);
+      CHECK(cmdl.transcoded<char16_t>(1) == utf16);
+      CHECK(!cmdl.utf8(u"missing"));
+      CHECK(!cmdl.utf8(2));
+   }
+   {
+      const wchar_t* argv[] = { L"-n", L"\u00efn", nullptr };
+      argh::view_parser<wchar_t> cmdl({ L"n" });
+      auto n = cmdl.intern(L"n");
+      cmdl.parse(argv);
+      CHECK(cmdl.utf8(n) == "\xC3\xAFn");
+   }
+   {
+      const char* argv[] = { "-n", utf8.c_str(), nullptr };
+      parser cmdl(argv, argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION);
+      CHECK(cmdl.utf8("n") == utf8);
+      CHECK(cmdl.transcoded<char16_t>("n") == utf16);
+   }
+   CHECK(argh::transcode<char>(std::u32string_view(utf32)) == utf8);
+   CHECK(argh::transcode<char32_t>(std::u16string_view(utf16)) == utf32);
+   CHECK(argh::transcode<char16_t>(std::string_view(utf8)) == utf16);
+   // invalid input: a lone surrogate, a truncated sequence and an overlong '/'
+   CHECK(argh::transcode<char>(std::u16string_view(u"a\xD800" u"b", 3)) == "a\xEF\xBF\xBD" "b");
+   CHECK(argh::transcode<char32_t>(std::string_view("\xE2\x82")) == U"\uFFFD\uFFFD");
+   CHECK(argh::transcode<char32_t>(std::string_view("\xC0\xAF")) == U"\uFFFD\uFFFD");
+}
+
+TEST_CASE("Test frozen snapshots")
+{
+   std::shared_ptr<argh::snapshot<> const> frozen;
+   {
+      std::vector<std::string> args = { "prog", "-v", "--threads", "8", "-I", "a", "--output=o.txt", "-I", "b", "2.5", "-x" };
+      parser cmdl(test_schema);
+      cmdl.add_params({ "I" });
+      cmdl.parse(std::move(args));
+      frozen = cmdl.freeze();
+   } // outlives the parser and its args
+
+   auto const& s = *frozen;
+   CHECK(s["verbose"]);
+   CHECK(s["-v"]);
+   CHECK(s["x"]);
+   CHECK(!s["missing"]);
+   CHECK(2 == s.size());
+   CHECK(s[0] == "prog");
+   CHECK(s[5].empty());
+   CHECK(s.param("t") == "8");
+   CHECK(s.param("output") == "o.txt");
+   CHECK(!s.param("missing"));
+   CHECK(s.get("threads", 0) == 8);
+   CHECK(s.get("threads", 0u) == 8u);
+   CHECK(s.get("threads", 0.0) == 8.0);
+   CHECK(s.get(1, 0.0) == 2.5);
+   CHECK(s.get(1, 0) == 2); // the numeric prefix, as convert() does
+   CHECK(s.get("output", 7) == 7);
+   CHECK(s.get("output", std::string()) == "o.txt");
+   CHECK(!s.try_get<char>("missing"));
+   auto values = s.values("I");
+   REQUIRE(2 == values.size());
+   CHECK(values[0] == "a");
+   CHECK(values[1] == "b");
+   CHECK(s.values("missing").empty());
+   CHECK(2 == s.flags().size());
+
+   // concurrent readers
+   std::atomic<int> wrong{ 0 };
+   std::vector<std::thread> readers;
+   for (int t = 0; t < 4; ++t)
+      readers.emplace_back([&, shared = frozen]
+      {
+         for (int i = 0; i < 1000; ++i)
+            wrong += !(*shared)["verbose"] || 8 != shared->get("t", 0) || "a" != shared->values("I")[0];
+      });
+   for (auto& reader : readers)
+      reader.join();
+   CHECK(0 == wrong);
+}
+
+TEST_CASE("Test abbreviations")
+{
+   const char* argv[] = { "prog", "--verb", "--thr", "4", "--out=o.txt", "--l", "x", "--len", "y", "-v", "--missing", nullptr };
+   parser cmdl(test_schema);
+   cmdl.add_params({ "level", "length" });
+   cmdl.parse(argv, argh::Mode::ALLOW_ABBREVIATIONS);
+   CHECK(cmdl["verbose"]);
+   CHECK(!cmdl["verb"]);
+   CHECK(cmdl.get("threads", 0) == 4);
+   CHECK(cmdl("output").str() == "o.txt");
+   CHECK(cmdl["l"]); // ambiguous, left as given
+   CHECK(cmdl("length").str() == "y");
+   CHECK(cmdl["missing"]);
+   CHECK(cmdl[1] == "x");
+
+   CHECK(argh::option_match<>::exact == cmdl.match("--threads").result);
+   CHECK(cmdl.match("thre").name == "threads");
+   CHECK(argh::option_match<>::exact == cmdl.match("x").result);
+   auto ambiguous = cmdl.match("le");
+   CHECK(argh::option_match<>::ambiguous == ambiguous.result);
+   CHECK(ambiguous.candidates == std::vector<std::string_view>{ "length", "level" });
+   CHECK(argh::option_match<>::none == cmdl.match("levels").result);
+   CHECK(argh::option_match<>::none == cmdl.match("z").result);
+
+   {
+      // off by default, and only for --long options
+      parser plain(test_schema);
+      plain.parse(argv);
+      CHECK(plain["verb"]);
+      CHECK(!plain.try_get<int>("threads"));
+      const char* single[] = { "-verb", nullptr };
+      parser abbreviated(test_schema);
+      abbreviated.parse(single, argh::Mode::ALLOW_ABBREVIATIONS);
+      CHECK(abbreviated["verb"]);
+   }
+   {
+      // expanded names of a view_parser survive more registrations
+      argh::view_parser<char, argh::flat_storage> views(test_schema);
+      views.parse(argv, argh::Mode::ALLOW_ABBREVIATIONS);
+      for (int i = 0; i < 20; ++i)
+         views.add_param("p" + std::to_string(i));
+      CHECK(views["verbose"]);
+      CHECK(views.get("threads", 0) == 4);
+      auto const lines = views.parse_batch({ { 3, argv } }, argh::Mode::ALLOW_ABBREVIATIONS);
+      CHECK(lines[0]["verbose"]);
+
+      // registering outdates the index, the next lookup rebuilds it
+      views.add_param("p-late");
+      CHECK(views.match("p-la").name == "p-late");
+      CHECK(views["verbose"]);
+      auto copy = views;
+      copy.add_param("q-late");
+      CHECK(copy.match("q-la").name == "q-late");
+      CHECK(argh::option_match<>::none == views.match("q-la").result);
+   }
+}
+
+TEST_CASE("Test subcommands")
+{
+   int built = 0;
+   argh::command_tree<> tool([&](auto& p) { ++built; p.add_params({ "config" }); });
+   tool.add("build", [&](auto& p) { ++built; p.add_params({ "jobs" }); });
+   auto& remote = tool.add("remote", [&](auto& p) { ++built; p.use_schema(test_schema); });
+   remote.add("add", [&](auto& p) { ++built; p.add_params({ "name" }); });
+   tool.add("run", [&](auto&) { ++built; });
+
+   {
+      const char* argv[] = { "tool", "--config", "build", "-v", "build", "--jobs", "4", "target", "run", nullptr };
+      auto& cmd = tool.parse(argv);
+      CHECK(2 == built); // only the commands used were set up
+      CHECK(cmd.name() == "build");
+      CHECK(cmd.parent() == &tool);
+      CHECK(tool.active() == &cmd);
+      CHECK(tool.args()("config").str() == "build");
+      CHECK(tool.args()["v"]);
+      CHECK(1 == tool.args().size());
+      CHECK(cmd.args().get("jobs", 0) == 4);
+      CHECK(3 == cmd.args().size()); // "run" is an arg of build, which has no subcommands
+      CHECK(cmd.args()[0] == "build");
+      CHECK(cmd.args()[2] == "run");
+   }
+   {
+      const char* argv[] = { "tool", "remote", "-t", "2", "add", "--name", "origin", "url", nullptr };
+      auto& cmd = tool.parse(argv);
+      CHECK(4 == built);
+      CHECK(cmd.name() == "add");
+      CHECK(cmd.parent()->name() == "remote");
+      CHECK(cmd.args()("name").str() == "origin");
+      CHECK(cmd.args()[1] == "url");
+      CHECK(cmd.parent()->args().get("threads", 0) == 2);
+      CHECK(!tool.args()["v"]); // the last results are replaced
+      CHECK(!tool.find("build")->args()("jobs"));
+   }
+   {
+      const char* argv[] = { "tool", "--config=x", nullptr };
+      auto& cmd = tool.parse(argv);
+      CHECK(&cmd == &tool);
+      CHECK(!tool.active());
+      CHECK(tool.args()("config").str() == "x");
+      CHECK(!tool.find("missing"));
+   }
+}
+
+TEST_CASE("Test environment fallback")
+{
+   temp_env threads("ARGH_TEST_THREADS", "6");
+   temp_env output("ARGH_TEST_OUTPUT", "env.txt");
+   temp_env level("ARGH_TEST_LOG_LEVEL", "3");
+   temp_env other("ARGH_TEST_OTHER_LEVEL", "9");
+   {
+      const char* argv[] = { "prog", "--output", "argv.txt", nullptr };
+      parser cmdl(test_schema);
+      cmdl.add_params({ "log-level" });
+      cmdl.env_prefix("ARGH_TEST_");
+      auto handle = cmdl.intern("threads");
+      cmdl.parse(argv);
+      CHECK(cmdl.get("threads", 0) == 6);
+      CHECK(cmdl.get("t", 0) == 6);
+      CHECK(cmdl.get(handle, 0) == 6);
+      CHECK(cmdl("output").str() == "argv.txt"); // argv first
+      CHECK(cmdl.get("log-level", 0) == 3);
+      CHECK(cmdl.get("missing", 1) == 1);        // then the default
+      CHECK(!cmdl["verbose"]);                   // flags are not bound
+      CHECK(cmdl.params().size() == 1);
+      auto frozen = cmdl.freeze(); // holds the fallback values too
+      CHECK(frozen->get("threads", 0) == 6);
+      CHECK(frozen->get("t", 0) == 6);
+      CHECK(frozen->param("output") == "argv.txt");
+      CHECK(frozen->values("output").size() == 1);
+      CHECK(frozen->get("log-level", 0) == 3);
+      CHECK(!frozen->param("missing"));
+      cmdl.reset();
+      CHECK(!cmdl.try_get<int>("threads"));
+      CHECK(!cmdl.freeze()->param("threads"));
+   }
+   {
+      // an explicit binding wins over the prefix, and works without registering
+      argh::view_parser<wchar_t, argh::flat_storage> cmdl({ L"log-level" });
+      cmdl.env_prefix("ARGH_TEST_");
+      cmdl.bind_env(L"--log-level", "ARGH_TEST_OTHER_LEVEL");
+      cmdl.bind_env(L"out", "ARGH_TEST_OUTPUT");
+      const wchar_t* wargv[] = { L"prog", nullptr };
+      cmdl.parse(wargv);
+      auto const copy = cmdl;
+      CHECK(copy.get(L"log-level", 0) == 9);
+      CHECK(copy(L"out").str() == L"env.txt");
+      CHECK(copy.freeze()->get(L"log-level", 0) == 9);
+   }
+}
+
+TEST_CASE("Test saved snapshots")
+{
+   const char* argv[] = { "prog", "-v", "-t", "8", "-I", "a", "-I", "b", "in", nullptr };
+   auto const key = argh::hash_args(9, argv);
+   const char* split[] = { "pr", "og" };
+   const char* joined[] = { "prog" };
+   CHECK(argh::hash_args(2, split) != argh::hash_args(1, joined));
+   const char* marked[] = { "a\xff", "" };
+   const char* empty[] = { "a", "", "" };
+   CHECK(argh::hash_args(2, marked) != argh::hash_args(3, empty));
+   CHECK(argh::hash_args(1, empty) != argh::hash_args(2, empty));
+   const char16_t* wide[] = { u"a\xff", u"" };
+   const char16_t* wide_empty[] = { u"a", u"", u"" };
+   CHECK(argh::hash_args(2, wide) != argh::hash_args(3, wide_empty));
+
+   char const* path = "argh_test_snapshot.bin";
+   temp_file cleanup(path, std::string()); // replaced by save()
+   {
+      parser cmdl(test_schema);
+      cmdl.add_params({ "I" });
+      cmdl.parse(argv);
+      REQUIRE(cmdl.freeze(key)->save(path));
+   }
+   {
+      auto loaded = argh::snapshot<>::load(path, key);
+      REQUIRE(loaded);
+      auto const& s = *loaded;
+      CHECK(s.key() == key);
+      CHECK(s["verbose"]);
+      CHECK(s["v"]); // the aliases are in the blob
+      CHECK(s.get("threads", 0) == 8);
+      CHECK(s.get("t", 0.0) == 8.0);
+      CHECK(2 == s.size());
+      CHECK(s[1] == "in");
+      auto values = s.values("I");
+      REQUIRE(2 == values.size());
+      CHECK(values[1] == "b");
+      CHECK(std::vector<std::string_view>(values.begin(), values.end()) == std::vector<std::string_view>{ "a", "b" });
+      CHECK(!s.param("missing"));
+   }
+   CHECK(!argh::snapshot<>::load(path, key + 1));
+   CHECK(!argh::snapshot<>::load("missing.bin", key));
+   CHECK(!argh::snapshot<wchar_t>::load(path, key)); // another CharType
+   {
+      // truncated or damaged blobs are refused
+      auto bytes = std::string(argh::snapshot<>::load(path, key)->bytes());
+      temp_file truncated("argh_test_truncated.bin", bytes.substr(0, bytes.size() - 1));
+      CHECK(!argh::snapshot<>::load(truncated.path.c_str(), key));
+      bytes[sizeof(argh::detail::blob_header)] = '\x7F'; // the offset of the first flag
+      temp_file damaged("argh_test_damaged.bin", bytes);
+      CHECK(!argh::snapshot<>::load(damaged.path.c_str(), key));
+   }
+   {
+      const wchar_t* wargv[] = { L"-n", L"1", nullptr };
+      argh::view_parser<wchar_t> cmdl({ L"n" });
+      cmdl.parse(wargv);
+      auto frozen = cmdl.freeze();
+      temp_file wide("argh_test_wide.bin", std::string(frozen->bytes()));
+      auto loaded = argh::snapshot<wchar_t>::load(wide.path.c_str(), 0);
+      REQUIRE(loaded);
+      CHECK(loaded->get(L"n", 0) == 1);
+   }
+}
+
+namespace
+{
+   // records the events of parser::visit()
+   struct recorder
+   {
+      std::vector<std::string> positionals;
+      std::set<std::string> flags;
+      std::vector<std::pair<std::string, std::string>> params;
+
+      void on_positional(std::string_view arg)               { positionals.emplace_back(arg); }
+      void on_flag(std::string_view name)                    { flags.emplace(name); }
+      void on_param(std::string_view name, std::string_view val) { params.emplace_back(name, val); }
+   };
+}
+
+TEST_CASE("Test visiting events")
+{
+   const char* argv[] = { "prog", "-v", "-t", "4", "--out=o.txt", "in1", "-abc", "-x", "-5", "in2", "--level", "2",
+                          "-I", "a", "-I", "b", "last", nullptr };
+   for (int mode : { int(argh::Mode::PREFER_FLAG_FOR_UNREG_OPTION), int(argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION),
+                     int(argh::Mode::SINGLE_DASH_IS_MULTIFLAG), int(argh::Mode::NO_SPLIT_ON_EQUALSIGN) })
+   {
+      parser cmdl(test_schema);
+      cmdl.add_params({ "level", "I" });
+      recorder events;
+      cmdl.visit(argv, events, mode);
+      CHECK(cmdl.size() == 0); // nothing stored
+
+      cmdl.parse(argv, mode);
+      CHECK(std::equal(events.positionals.begin(), events.positionals.end(), cmdl.pos_args().begin(), cmdl.pos_args().end()));
+      CHECK(std::equal(events.flags.begin(), events.flags.end(), cmdl.flags().begin(), cmdl.flags().end()));
+      REQUIRE(events.params.size() == cmdl.params().size() + (cmdl.values("I").size() - (cmdl.values("I").empty() ? 0 : 1)));
+      for (auto const& param : events.params)
+         CHECK(cmdl.params().count(param.first));
+   }
+
+   {
+      // response files are streamed too
+      temp_file rsp("argh_test_visit.rsp", "-t 2 'a b' @argh_test_visit.rsp\n");
+      const char* rsp_argv[] = { "prog", "@argh_test_visit.rsp", "-v", nullptr };
+      parser cmdl(test_schema);
+      recorder events;
+      cmdl.visit(rsp_argv, events, argh::Mode::EXPAND_RESPONSE_FILES);
+      CHECK(events.flags.count("verbose"));
+      REQUIRE(2 <= events.positionals.size());
+      CHECK(events.positionals[1] == "a b");
+      CHECK(events.params.front() == std::make_pair(std::string("threads"), std::string("2")));
+   }
+}
+
+TEST_CASE("Test config files")
+{
+   temp_file base("argh_test_base.ini",
+      "\xEF\xBB\xBF# defaults\n"
+      "threads = 2\n"
+      "output = 'base.txt'\n"
+      "verbose\n"
+      "; sections prefix their keys\n"
+      "[net]\r\n"
+      "port = 80\r\n"
+      "host=\"example.org\"  \n"
+      "[ log ]\n"
+      "level = 1\n"
+      "level = 2\n");
+   temp_file local("argh_test_local.ini", "[net]\nport = 8080\nbad line = \n= no key\n");
+   temp_env env_level("ARGH_TEST_LOG_LEVEL", "5");
+
+   const char* argv[] = { "prog", "-t", "8", "in", nullptr };
+   parser cmdl(test_schema);
+   auto port = cmdl.intern("net.port");
+   CHECK(!cmdl.load_config("argh_test_missing.ini"));
+   REQUIRE(cmdl.load_config("argh_test_base.ini"));
+   CHECK(cmdl.get(port, 0) == 80); // before any parse
+   REQUIRE(cmdl.load_config("argh_test_local.ini"));
+   cmdl.bind_env("log.level", "ARGH_TEST_LOG_LEVEL");
+   cmdl.parse(argv);
+
+   CHECK(cmdl.get("threads", 0) == 8);               // argv first
+   CHECK(cmdl.get("log.level", 0) == 5);             // then the environment
+   CHECK(cmdl.get(port, 0) == 8080);                 // then the last file
+   CHECK(cmdl("net.host").str() == "example.org");
+   CHECK(cmdl("output").str() == "base.txt");
+   CHECK(cmdl("bad line").str() == "");
+   CHECK(cmdl["verbose"]);
+   CHECK(cmdl[port] == false);
+   CHECK(cmdl.params().size() == 1);                 // the results are argv's
+   CHECK(cmdl.pos_args().size() == 2);
+
+   CHECK(cmdl.origin("-t").source == argh::value_source::command_line);
+   CHECK(cmdl.origin("log.level").source == argh::value_source::environment);
+   auto from = cmdl.origin("net.port");
+   CHECK(from.source == argh::value_source::config_file);
+   CHECK(from.file == "argh_test_local.ini");
+   CHECK(from.line == 2);
+   CHECK(cmdl.origin("verbose").line == 4);
+   CHECK(cmdl.origin("missing").source == argh::value_source::none);
+
+   // snapshots hold what the parser falls back to
+   auto frozen = cmdl.freeze();
+   CHECK(frozen->get("threads", 0) == 8);
+   CHECK(frozen->get("log.level", 0) == 5);
+   CHECK(frozen->get("net.port", 0) == 8080);
+   CHECK(frozen->param("net.host") == "example.org");
+   CHECK((*frozen)["verbose"]);
+   CHECK(!(*frozen)["net.port"]);
+   CHECK(1 == frozen->flags().size());
+
+   // kept by reset(), until clear_config()
+   cmdl.reset();
+   CHECK(cmdl("net.host").str() == "example.org");
+   cmdl.clear_config();
+   CHECK(!cmdl["verbose"]);
+   CHECK(!cmdl(port));
+
+   // values point into the mapped file
+   argh::view_parser<> views;
+   REQUIRE(views.load_config("argh_test_base.ini"));
+   auto host = views("net.host").str();
+   argh::view_parser<> copy = views;
+   views.clear_config();
+   CHECK(copy("net.host").str() == host);
+
+   argh::parser<wchar_t> wide;
+   REQUIRE(wide.load_config(L"argh_test_base.ini"));
+   CHECK(wide(L"net.host").str() == L"example.org");
+}
+
+TEST_CASE("Test completion")
+{
+   parser cmdl(test_schema);
+   cmdl.add_params({ "out-dir", "a:b" });
+   auto candidates = [&](std::vector<const char*> words, size_t cursor)
+   {
+      std::vector<std::string> found;
+      cmdl.complete(words.size(), words.data(), cursor, [&](std::string_view dashes, std::string_view name, bool param)
+      {
+         found.push_back(std::string(dashes) + std::string(name) + (param ? "=" : ""));
+      });
+      return found;
+   };
+
+   CHECK(candidates({ "prog", "--ou" }, 1) == std::vector<std::string>{ "--out-dir=", "--output=" });
+   CHECK(candidates({ "prog", "-v", "--th" }, 2) == std::vector<std::string>{ "--threads=" });
+   CHECK(candidates({ "prog", "-x" }, 1) == std::vector<std::string>{ "-x" }); // a whole name too
+   CHECK(candidates({ "prog", "-" }, 1).size() == 6);
+   CHECK(candidates({ "prog", "--" }, 1).front() == "--a:b=");
+   CHECK(candidates({ "prog", "--output" }, 2).empty()); // a new word, not an option yet
+   CHECK(candidates({ "prog", "in" }, 1).empty());
+   CHECK(candidates({ "prog", "-5" }, 1).empty());
+   CHECK(candidates({ "prog", "--output=o" }, 1).empty());
+   CHECK(candidates({ "prog", "--zz" }, 1).empty());
+   CHECK(candidates({ "prog", "--ou" }, 0).empty());
+   CHECK(candidates({ "prog", "--ou" }, 3).empty());
+   CHECK(cmdl.size() == 0); // nothing parsed
+
+   std::ostringstream bash, zsh, fish;
+   const char* words[] = { "prog", "--a", nullptr };
+   cmdl.write_completions(bash, argh::shell::bash, 2, words, 1);
+   cmdl.write_completions(zsh, argh::shell::zsh, 2, words, 1);
+   cmdl.write_completions(fish, argh::shell::fish, 2, words, 1);
+   CHECK(bash.str() == "--a:b\n");
+   CHECK(zsh.str() == "--a\\:b:takes a value\n");
+   CHECK(fish.str() == "--a:b\ttakes a value\n");
+
+   // the request of a completion script
+   std::ostringstream served;
+   const char* request[] = { "prog", "__complete", "fish", "1", "prog", "--v", nullptr };
+   CHECK(cmdl.serve_completion(6, request, served));
+   CHECK(served.str() == "--verbose\n");
+   CHECK(!cmdl.serve_completion(2, words, served));
+
+   argh::parser<wchar_t> wide({ L"level" });
+   std::wostringstream wout;
+   const wchar_t* wrequest[] = { L"prog", L"__complete", L"zsh", L"1", L"prog", L"--l", nullptr };
+   CHECK(wide.serve_completion(6, wrequest, wout));
+   CHECK(wout.str() == L"--level:takes a value\n");
+
+   auto script = argh::completion_script(argh::shell::bash, "my-prog");
+   CHECK(script.find("_my_prog_argh_complete()") != std::string::npos);
+   CHECK(script.find("complete -o default -F _my_prog_argh_complete my-prog") != std::string::npos);
+   CHECK(argh::completion_script(argh::shell::zsh, "p").find("#compdef p") == 0);
+   CHECK(argh::completion_script(argh::shell::fish, "p").find("complete -c p") != std::string::npos);
+}
+
+TEST_CASE("Test feeding args")
+{
+   const char* argv[] = { "prog", "-v", "-t", "4", "--out=o.txt", "in1", "-abc", "-x", "-5", "in2", "--level", "2",
+                          "-I", "a", "-I", "b", "last", nullptr };
+   for (int mode : { int(argh::Mode::PREFER_FLAG_FOR_UNREG_OPTION), int(argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION),
+                     int(argh::Mode::SINGLE_DASH_IS_MULTIFLAG), int(argh::Mode::NO_SPLIT_ON_EQUALSIGN) })
+   {
+      parser fed(test_schema), parsed(test_schema);
+      fed.add_params({ "level", "I" });
+      parsed.add_params({ "level", "I" });
+      for (auto arg = argv; *arg; ++arg)
+         fed.feed(std::string(*arg), mode); // gone after the call
+      parsed.parse(argv, mode);
+      CHECK(fed.pos_args() == parsed.pos_args());
+      CHECK(fed.flags() == parsed.flags());
+      CHECK(fed.params() == parsed.params());
+      CHECK(fed.values("I").size() == parsed.values("I").size());
+   }
+
+   // decided as soon as the next arg comes
+   argh::view_parser<char, argh::flat_storage> cmdl(test_schema);
+   auto threads = cmdl.intern("threads");
+   cmdl.feed(std::string("prog"));
+   CHECK(!cmdl(0)); // held
+   CHECK(!cmdl.cached<int>("threads"));
+   CHECK(!cmdl.cached<int>(threads));
+   cmdl.feed(std::string("-t"));
+   CHECK(cmdl(0).str() == "prog");
+   cmdl.feed(std::string("8"));
+   CHECK(cmdl.get("threads", 0) == 8);
+   cmdl.feed(std::string("-v"));
+   CHECK(!cmdl["verbose"]); // held, it may be a param
+   auto copy = cmdl;
+   cmdl.feed(std::string("in"));
+   CHECK(cmdl["verbose"]);
+   CHECK(!cmdl[threads]); // resolved by finish()
+   cmdl.finish();
+   CHECK(cmdl.get(threads, 0) == 8);
+   REQUIRE(cmdl.cached<int>("threads")); // dropped by finish(), not kept from before the value
+   CHECK(*cmdl.cached<int>("threads") == 8);
+   CHECK(*cmdl.cached<int>(threads) == 8);
+   CHECK(cmdl.pos_args().size() == 2);
+
+   // a copy holds the same arg, and its views stay valid
+   CHECK(!copy["verbose"]);
+   CHECK(copy.size() == 1);
+   CHECK(copy["verbose"]);
+   CHECK(copy("threads").str() == "8");
+
+   // a new feed adds to the results, reset() drops the held arg
+   cmdl.feed(std::string("--output"));
+   cmdl.feed(std::string("o.txt"));
+   CHECK(cmdl("output").str() == "o.txt");
+   cmdl.feed(std::string("-x"));
+   cmdl.reset();
+   CHECK(!cmdl["x"]);
+   CHECK(cmdl.size() == 0);
+}
+
+TEST_CASE("Test cached conversions")
+{
+   const char* argv[] = { "prog", "--rate", "44100", "-t", "4", "--name", "x y", "--bad", "abc", nullptr };
+   parser cmdl(test_schema);
+   auto rate = cmdl.add_param("rate");
+   cmdl.add_params({ "name", "bad" });
+   cmdl.parse(argv);
+
+   int const* first = cmdl.cached<int>(rate);
+   REQUIRE(first);
+   CHECK(*first == 44100);
+   CHECK(cmdl.cached<int>(rate) == first); // kept, not converted again
+   CHECK(cmdl.cached<int>("--rate") == first); // a name shares the slot of its handle
+   CHECK(*cmdl.cached<int>("--rate") == 44100);
+   CHECK(cmdl.cached<double>(rate) != nullptr);
+   CHECK(*cmdl.cached<double>(rate) == 44100.0);
+   CHECK(*cmdl.cached<std::string>("name") == "x y");
+   CHECK(*cmdl.cached<int>("threads") == 4);
+
+   // missing or not convertible
+   CHECK(cmdl.cached<int>("bad") == nullptr);
+   CHECK(cmdl.cached<int>("missing") == nullptr);
+   CHECK(cmdl.cached<int>(argh::option_handle()) == nullptr);
+
+   // defaults are not kept: each call gets its own
+   CHECK(cmdl.cached("bad", 7) == 7);
+   CHECK(cmdl.cached("bad", 8) == 8);
+   CHECK(cmdl.cached("missing", 9) == 9);
+   CHECK(cmdl.cached(rate, 1) == 44100);
+   CHECK(cmdl.cached("rate", 1) == 44100);
+   CHECK(cmdl.cached<std::string>("name", "") == "x y");
+   CHECK(cmdl.cached(argh::option_handle(), 3) == 3);
+
+   // concurrent readers all get the one kept value
+   std::vector<std::thread> readers;
+   std::atomic<int> agreed{ 0 };
+   for (int t = 0; t < 4; ++t)
+      readers.emplace_back([&] { for (int i = 0; i < 100; ++i) agreed += cmdl.cached<long>("rate") == cmdl.cached<long>(rate) && 44100 == *cmdl.cached<long>(rate); });
+   // names without a handle too, each thread asking for its own ones first
+   for (int t = 0; t < 4; ++t)
+      readers.emplace_back([&, t]
+      {
+         for (int i = 0; i < 100; ++i)
+         {
+            auto own = "missing-" + std::to_string((t + i) % 8);
+            agreed += !cmdl.cached<int>(own) && cmdl.cached<std::string>("name") == cmdl.cached<std::string>("--name");
+         }
+      });
+   for (auto& reader : readers)
+      reader.join();
+   CHECK(agreed == 800);
+   CHECK(*cmdl.cached<std::string>("name") == "x y");
+
+   // a new parse drops them, copies start empty
+   const char* again[] = { "prog", "--rate", "48000", nullptr };
+   parser copy = cmdl;
+   CHECK(*copy.cached<int>(rate) == 44100);
+   cmdl.reparse(again);
+   CHECK(*cmdl.cached<int>(rate) == 48000);
+   CHECK(*cmdl.cached<int>("rate") == 48000);
+   CHECK(cmdl.cached("bad", 8) == 8);
+   CHECK(*copy.cached<int>(rate) == 44100);
+}
+
+namespace
+{
+   // parse<M>() and the runtime parse() with M give the same results
+   template<int M>
+   void check_fixed_mode(const char* const argv[])
+   {
+      parser fixed(test_schema), runtime(test_schema);
+      fixed.add_params({ "level", "I" });
+      runtime.add_params({ "level", "I" });
+      fixed.template parse<M>(argv);
+      runtime.parse(argv, M);
+      CHECK(fixed.pos_args() == runtime.pos_args());
+      CHECK(fixed.flags() == runtime.flags());
+      CHECK(fixed.params() == runtime.params());
+      CHECK(fixed.values("I").size() == runtime.values("I").size());
+   }
+}
+
+TEST_CASE("Test compile-time modes")
+{
+   const char* argv[] = { "prog", "-v", "-t", "4", "--out=o.txt", "in1", "-abc", "-x", "-5", "in2", "--level", "2",
+                          "-I", "a", "-I", "b", "--verb", "last", nullptr };
+   check_fixed_mode<argh::Mode::PREFER_FLAG_FOR_UNREG_OPTION>(argv);
+   check_fixed_mode<argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION>(argv);
+   check_fixed_mode<argh::Mode::PREFER_FLAG_FOR_UNREG_OPTION | argh::Mode::NO_SPLIT_ON_EQUALSIGN>(argv);
+   check_fixed_mode<argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION | argh::Mode::SINGLE_DASH_IS_MULTIFLAG>(argv);
+   check_fixed_mode<argh::Mode::SINGLE_DASH_IS_MULTIFLAG | argh::Mode::ALLOW_ABBREVIATIONS>(argv);
+   check_fixed_mode<argh::Mode::LAZY_PARSE>(argv);
+
+   parser cmdl;
+   const char* unreg[] = { "prog", "-x", "value", "-y", "in", nullptr };
+   cmdl.parse<argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION>(3, unreg);
+   CHECK(cmdl("x").str() == "value");
+   CHECK(cmdl.pos_args().size() == 1);
+
+   static_assert(argh::valid_mode(argh::Mode::PREFER_FLAG_FOR_UNREG_OPTION | argh::Mode::LAZY_PARSE), "");
+   static_assert(!argh::valid_mode(argh::Mode::PREFER_FLAG_FOR_UNREG_OPTION | argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION), "");
+   static_assert(argh::fixed_mode<argh::Mode::NO_SPLIT_ON_EQUALSIGN>::value == argh::Mode::NO_SPLIT_ON_EQUALSIGN, "");
+}
+
+#if defined(ARGH_ENABLE_STATS)
+TEST_CASE("Test parse stats")
+{
+   const char* argv[] = { "-1", "-a", "a-positional-argument-longer-than-sso", "--b=2", "/c", "-d", "-3.5", nullptr };
+   {
+      parser cmdl(argv, argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION);
+      auto const& stats = cmdl.stats();
+      CHECK(7 == stats.tokens);
+      CHECK(5 == stats.number_probes);
+      CHECK(0 < stats.container_allocations);
+      CHECK(2 <= stats.string_allocations); // the long token in args_ and as the value of 'a'
+      CHECK(stats.classify_time.count() >= 0);
+      CHECK(stats.insert_time.count() >= 0);
+
+      // only what this parse stored, not the results of the one before
+      const char* shorter[] = { "-e", "5", "in", nullptr };
+      cmdl.parse(shorter, argh::Mode::PREFER_PARAM_FOR_UNREG_OPTION);
+      REQUIRE(cmdl("a"));
+      CHECK(0 == stats.string_allocations);
+   }
+   {
+      argh::view_parser<char32_t, argh::flat_storage> cmdl;
+      const char32_t* wargv[] = { U"-a", U"1", nullptr };
+      cmdl.parse(wargv);
+      CHECK(2 == cmdl.stats().tokens);
+      CHECK(0 == cmdl.stats().string_allocations);
+      CHECK(0 < cmdl.stats().container_allocations);
+   }
+}
+#endif
+
 TEST_CASE("Test size() wide member function")
 {
 	{
@@ -872,8 +2384,9 @@ TEST_CASE("Test un-reg option modes")
 	}
 }
 
-// after testing, MS STL support for u8string u16string and u32string seem to be incomplete for now
-#if 0
+// after testing, MS STL support for u8string u16string and u32string seem to be incomplete for now.
+// parsing no longer streams through the (missing) char32_t facets, so other standard libraries run it.
+#if !defined(_MSC_VER)
 TEST_CASE("Test UTF-32 initializer list ctor for preregistered params")
 {
 	const char32_t* argv[] = { U"-a",U"1",U"-b",U"2", nullptr };